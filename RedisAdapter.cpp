@@ -1,9 +1,11 @@
 //
 //  RedisAdapter.cpp
 //
-//  This file contains the implementation of the RedisAdapter class
+//  This file contains the implementation of the RedisHub and RedisAdapter classes
 
 #include "RedisAdapter.hpp"
+#include <random>
+#include <charconv>
 
 using namespace std;
 using namespace chrono;
@@ -25,27 +27,46 @@ static uint64_t nanoseconds_since_epoch()
 //
 //    id     : Redis ID string e.g. "12345-67089" where the first number is milliseconds since
 //             epoch and the second number is the nanoseconds remainder
-//    return : RA_Time
+//    return : RA_Time, zero if the ID is not a number
 //
-RA_Time::RA_Time(const string& id)
+//  This runs for every entry read, so it parses in place (no copies, no exceptions)
+//
+RA_Time::RA_Time(string_view id) : value(0)
 {
-  try
-  {
-    value = stoll(id) * NANOS_PER_MILLI;
-    size_t pos = id.find('-');
-    if (pos != string::npos) { value += stoll(id.substr(pos + 1)); }
-  }
-  catch (...) { value = 0; }
+  const char* end = id.data() + id.size();
+  int64_t millis = 0, nanos = 0;
+
+  auto [pos, err] = from_chars(id.data(), end, millis);
+  if (err != errc()) return;
+
+  if (pos != end && *pos == '-' && from_chars(pos + 1, end, nanos).ec != errc()) return;
+
+  value = millis * NANOS_PER_MILLI + nanos;
 }
 
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-//  RA_Time::id : return Redis ID string
+//  RA_Time::chars : return Redis ID in a fixed buffer
+//  RA_Time::id    : return Redis ID string
 //
-string RA_Time::id() const
+RA_Time::Chars RA_Time::chars() const
 {
+  Chars ret;
+  if ( ! ok()) { memcpy(ret.data, "0-0", 3); ret.size = 3; return ret; }
+
   //  place the whole milliseconds on the left-hand side of the ID
   //  and the remainder nanoseconds on the right-hand side of the ID
-  return ok() ? to_string(value / NANOS_PER_MILLI) + "-" + to_string(value % NANOS_PER_MILLI) : "0-0";
+  char* end = ret.data + sizeof(ret.data);
+  char* pos = to_chars(ret.data, end, value / NANOS_PER_MILLI).ptr;
+  *pos++ = '-';
+  pos = to_chars(pos, end, value % NANOS_PER_MILLI).ptr;
+  ret.size = pos - ret.data;
+  return ret;
+}
+
+string RA_Time::id() const
+{
+  Chars id = chars();
+  return string(id.data, id.size);
 }
 
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -57,215 +78,93 @@ string RA_Time::id_or_now() const
 }
 
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-//  RedisAdapter : constructor
+//  RedisHub : constructor
 //
-//    baseKey : base key of home device
 //    options : struct of default values, override using per-field initializer list
-//              e.g. { .user = "adinst", .password = "adinst" }
-//    return  : RedisAdapter
+//              (dogname is not used, each adapter has its own)
+//    return  : RedisHub
 //
-RedisAdapter::RedisAdapter(const string& baseKey, const RA_Options& options) :
-  _options(options), _redis(options.cxn), _base_key(baseKey), _connecting(false),
-  _watchdog_run(false), _readers_defer(false), _replier_pool(options.workers)
+RedisHub::RedisHub(const RA_Options& options) :
+  _options(options), _redis(options.cxn), _replier_pool(options.workers), _fanout_pool(options.fanout)
 {
-  _watchdog_key = build_key("watchdog");
-
-  if (_options.dogname.size())
-  {
-    _watchdog_thd = thread([&]()
-      {
-        mutex mx; unique_lock lk(mx);   //  dummies for _watchdog_cv
-
-        addWatchdog(_options.dogname, 1);
-
-        for (_watchdog_run = true;      //  every 900ms set expire for 1000ms
-             _watchdog_run && _watchdog_cv.wait_for(lk, milliseconds(900)) == cv_status::timeout;
-             petWatchdog(_options.dogname, 1)) {}
-      }
-    );
-  }
 }
 
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-//  ~RedisAdapter : destructor
+//  ~RedisHub : destructor
 //
-RedisAdapter::~RedisAdapter()
+RedisHub::~RedisHub()
 {
   _shutdown = true;
 
-  if (_watchdog_run.load())
   {
+    lock_guard<mutex> lk(_watchdog_mtx);
     _watchdog_run = false;
-    _watchdog_cv.notify_all();
-    _watchdog_thd.join();
   }
+  _watchdog_cv.notify_all();
+  if (_watchdog_thd.joinable()) _watchdog_thd.join();
 
-  if (_reconnect_thd.joinable()) _reconnect_thd.join();
-
-  std::lock_guard<std::mutex> lk(_reader_mtx);
-  for (auto& item : _reader) { stop_reader(item.first); }
-}
-
-//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-//  addSingleDouble : add a single data item of type double
-//
-//    subKey : sub key to add data to
-//    time   : time to add the data at
-//    data   : data to add
-//    trim   : number of items to trim the stream to
-//    return : time of the added data item if successful, zero on failure
-//
-RA_Time RedisAdapter::addSingleDouble(const string& subKey, double data, const RA_ArgsAdd& args)
-{
-  string key = build_key(subKey);
-  Attrs attrs = default_field_attrs(data);
-
-  string id = args.trim ? _redis.xaddTrim(key, args.time.id_or_now(), attrs.begin(), attrs.end(),
-                                         args.trim, args.approximateTrim)
-                        : _redis.xadd(key, args.time.id_or_now(), attrs.begin(), attrs.end());
-
-  if (reconnect(id.size()) == 0) { return RA_NOT_CONNECTED; }
-
-  return RA_Time(id);
-}
-
-//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-//  setDeferReaders : defer or un-defer addition and removal of readers
-//                    - deferring cancels all reads and stops all reader threads until un-defer
-//                    - un-deferring starts all reader threads
-//                    this prevents redundant thread destruction/creation and is
-//                    the preferred way to add/remove multiple readers at one time
-//
-//    defer   : whether to defer or un-defer addition and removal of readers
-//    return  : true on success, false on failure
-//
-bool RedisAdapter::setDeferReaders(bool defer)
-{
-  std::lock_guard<std::mutex> lk(_reader_mtx);
-  if (defer && ! _readers_defer.load())
   {
-    _readers_defer = defer;
-    for (auto& item : _reader) { stop_reader(item.first); }
+    lock_guard<mutex> lk(_reconnect_mtx);   //  cut short the reconnect thread's backoff
   }
-  else if ( ! defer && _readers_defer.load())
+  _reconnect_cv.notify_all();
+  if (_reconnect_thd.joinable()) _reconnect_thd.join();
+
+  //  stop the async thread - it completes everything already queued before it exits
   {
-    _readers_defer = defer;
-    for (auto& item : _reader) { start_reader(item.first); }
+    lock_guard<mutex> lk(_async_mtx);
+    _async_run = false;
   }
-  return true;
-}
-
-//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-//  addGenericReader : add a reader for a key that does NOT follow RedisAdapter schema
-//
-//    key     : the key to add (must NOT be a RedisAdapter schema key)
-//    func    : function to call when data is read - data will be RedisAdapter::Attrs
-//    return  : true if reader started, false if reader failed to start
-//
-bool RedisAdapter::addGenericReader(const string& key, ReaderSubFn<Attrs> func)
-{
-  if (split_key(key).first.size()) return false;  //  reject if basekey found
+  _async_cv.notify_all();
+  if (_async_thd.joinable()) _async_thd.join();
 
   std::lock_guard<std::mutex> lk(_reader_mtx);
-
-  uint32_t token = reader_token(key);
-  reader_info& info = _reader[token];
-
-  info.subs[key].push_back(make_reader_callback(func));
-  info.keyids[key] = "$";
-
-  if (token == NO_TOKEN) return false;
-
-  stop_reader(token);
-
-  if (info.stop.empty())
-  {
-    info.stop = build_key(STOP_STUB, key);
-    info.keyids[info.stop] = "$";
-  }
-  return start_reader(token);
+  stop_readers();
 }
 
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-//  removeGenericReader : remove all readers for a key that does NOT follow RedisAdapter schema
+//  adapters : number of adapters attached to this hub
 //
-//    key     : the key to remove (must NOT be a RedisAdapter schema key)
-//    return  : true if reader started, false if reader failed to start
-//
-bool RedisAdapter::removeGenericReader(const string& key)
+size_t RedisHub::adapters()
 {
-  if (split_key(key).first.size()) return false;  //  reject if basekey found
-
-  std::lock_guard<std::mutex> lk(_reader_mtx);
-
-  uint32_t token = reader_token(key);
-  if (token == NO_TOKEN || _reader.count(token) == 0) return false;
-
-  //  TODO: this is flawed - if NO_TOKEN (not connected) we need to search all buckets
-  //  for the key and remove it, also the NO_TOKEN bucket should be checked for every
-  //  remove to see if the key is in there - HOWEVER removing readers is very rare
-  //  (pretty much unheard of) so this is not a huge priority
-
-  stop_reader(token);
-  reader_info& info = _reader.at(token);
-  info.subs.erase(key);
-  info.keyids.erase(key);
+  lock_guard<mutex> lk(_attach_mtx);
+  return _attached.size();
+}
 
-  if (info.subs.empty())
-  {
-    _reader.erase(token);
-    return true;
-  }
-  return start_reader(token);
+void RedisHub::attach(RedisAdapter* ra)
+{
+  lock_guard<mutex> lk(_attach_mtx);
+  _attached.push_back(ra);
 }
 
-//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-//  Private methods
-//
-string RedisAdapter::build_key(const string& subKey, const string& baseKey) const
+void RedisHub::detach(RedisAdapter* ra)
 {
-  //  surround base key with {} to locate keys with same base key in same cluster slot
-  //  this mitgates CROSSSLOT errors for copyKey and renameKey but also puts all keys
-  //  for a base key onto the same reader thread (this could be mitigated with an additional
-  //  load balancing strategy of mutiple threads per slot if necessary)
-  //  NOTE - none of this has ANY effect for single instance (non-cluster) Redis servers
-  return "{" + (baseKey.size() ? baseKey : _base_key) + "}" + (subKey.size() ? ":" + subKey : "");
+  lock_guard<mutex> lk(_attach_mtx);
+  _attached.erase(remove(_attached.begin(), _attached.end(), ra), _attached.end());
 }
 
-pair<string, string> RedisAdapter::split_key(const string& key) const
+//  split a schema key {baseKey}:subKey (see RedisAdapter::build_key) into base and sub key,
+//  any other key gives empty strings
+pair<string, string> RedisHub::split_key(const string& key)
 {
-  size_t idx = key.find(_base_key), len = _base_key.size();
+  size_t end = key.find('}');
 
-  if (idx == string::npos) return {};
+  if (key.empty() || key[0] != '{' || end == string::npos) return {};
 
-  return make_pair(key.substr(idx, len),  //  look past the {} and :
-                   key.size() > idx + len + 1 ? key.substr(idx + len + 2) : "");
+  return make_pair(key.substr(1, end - 1),  //  look past the {} and :
+                   key.size() > end + 1 ? key.substr(end + 2) : "");
 }
 
-bool RedisAdapter::copy(const string& srcSubKey, const string& dstSubKey, const string& baseKey)
+//  the stream poked to stop the reader serving key - it must hash to the same slot
+string RedisHub::stop_key(const string& key) const
 {
-  string srcKey = build_key(srcSubKey, baseKey);
-  string dstKey = build_key(dstSubKey);
+  auto part = split_key(key);
 
-  int32_t ret = _redis.copy(srcKey, dstKey);
+  if (part.first.empty()) return "{" + key + "}:" + STOP_STUB;
 
-  //  WARNING - this cross-slot copy brings ALL the data from srcKey to the client computer for
-  //            manual re-add to dstKey - this is potentially network, memory and cpu intensive!
-  if (ret == -2 && _redis.exists(dstKey) == 0)
-  {
-    ItemStream raw;
-    if (_redis.xrange(srcKey, "-", "+", back_inserter(raw)))
-    {
-      string id;
-      for (auto& it : raw) { id = _redis.xadd(dstKey, it.first, it.second.begin(), it.second.end()); }
-      ret = id.size();
-    }
-  }
-  reconnect(ret != -1);   //  if ret == -1, pass 0 to reconnect
-  return ret > 0;
+  return "{" + part.first + "}:" + part.second + ":" + STOP_STUB;
 }
 
-uint32_t RedisAdapter::reader_token(const std::string& key)
+uint32_t RedisHub::reader_token(const std::string& key)
 {
   static hash<string> hasher;
 
@@ -279,16 +178,14 @@ uint32_t RedisAdapter::reader_token(const std::string& key)
   return token;
 }
 
-bool RedisAdapter::add_reader_helper(const string& baseKey, const string& subKey, reader_sub_fn func)
+bool RedisHub::add_reader(const void* owner, const string& key, reader_sub_fn func, const void* tag)
 {
-  string key = build_key(subKey, baseKey);
-
   std::lock_guard<std::mutex> lk(_reader_mtx);
 
   uint32_t token = reader_token(key);
   reader_info& info = _reader[token];
 
-  info.subs[key].push_back(func);
+  info.subs[key].push_back({ owner, tag, func });
   info.keyids[key] = "$";
 
   if (token == NO_TOKEN) return false;
@@ -297,16 +194,24 @@ bool RedisAdapter::add_reader_helper(const string& baseKey, const string& subKey
 
   if (info.stop.empty())
   {
-    info.stop = build_key(subKey + ":" + STOP_STUB, baseKey);
+    info.stop = stop_key(key);
     info.keyids[info.stop] = "$";
   }
   return start_reader(token);
 }
 
-bool RedisAdapter::remove_reader_helper(const string& baseKey, const string& subKey)
+bool RedisHub::remove_reader(const void* owner, const string& key, const void* tag)
 {
-  string key = build_key(subKey, baseKey);
+  bool ret = unlink_reader(owner, key, tag);
+
+  //  the reader may have queued callbacks for the key before it was stopped - wait for them
+  //  (outside the lock, they may add or remove readers) so the caller can free what they use
+  _replier_pool.drain(key);
+  return ret;
+}
 
+bool RedisHub::unlink_reader(const void* owner, const string& key, const void* tag)
+{
   std::lock_guard<std::mutex> lk(_reader_mtx);
 
   uint32_t token = reader_token(key);
@@ -319,8 +224,16 @@ bool RedisAdapter::remove_reader_helper(const string& baseKey, const string& sub
 
   stop_reader(token);
   reader_info& info = _reader.at(token);
-  info.subs.erase(key);
-  info.keyids.erase(key);
+
+  //  other adapters may still be reading this key
+  auto& subs = info.subs[key];
+  auto mine = [owner, tag](const reader_sub& sub) { return sub.owner == owner && ( ! tag || sub.tag == tag); };
+  subs.erase(remove_if(subs.begin(), subs.end(), mine), subs.end());
+  if (subs.empty())
+  {
+    info.subs.erase(key);
+    info.keyids.erase(key);
+  }
 
   if (info.subs.empty())
   {
@@ -330,7 +243,62 @@ bool RedisAdapter::remove_reader_helper(const string& baseKey, const string& sub
   return start_reader(token);
 }
 
-bool RedisAdapter::start_reader(uint32_t token)
+//  remove every reader an adapter added, restarting only the readers it shared
+void RedisHub::remove_readers(const void* owner)
+{
+  std::lock_guard<std::mutex> lk(_reader_mtx);
+
+  auto mine = [owner](const reader_sub& sub) { return sub.owner == owner; };
+
+  for (auto rdr = _reader.begin(); rdr != _reader.end(); )
+  {
+    reader_info& info = rdr->second;
+
+    if (none_of(info.subs.begin(), info.subs.end(),
+                [&](const auto& subs) { return any_of(subs.second.begin(), subs.second.end(), mine); }))
+    {
+      ++rdr;
+      continue;
+    }
+    stop_reader(rdr->first);
+
+    for (auto subs = info.subs.begin(); subs != info.subs.end(); )
+    {
+      subs->second.erase(remove_if(subs->second.begin(), subs->second.end(), mine), subs->second.end());
+      if (subs->second.size()) { ++subs; continue; }
+
+      info.keyids.erase(subs->first);
+      subs = info.subs.erase(subs);
+    }
+
+    if (info.subs.empty()) { rdr = _reader.erase(rdr); continue; }
+
+    start_reader(rdr->first);
+    ++rdr;
+  }
+}
+
+//  the readers stay stopped for as long as any adapter is deferring them
+bool RedisHub::defer_readers(bool defer)
+{
+  std::lock_guard<std::mutex> lk(_reader_mtx);
+  if (defer && _readers_defer++ == 0)
+  {
+    stop_readers();
+  }
+  else if ( ! defer && _readers_defer && --_readers_defer == 0)
+  {
+    //  start them all, then confirm them all, so the start up waits overlap
+    for (auto& item : _reader) { start_reader(item.first, false); }
+    for (auto& item : _reader) { confirm_reader(item.first); }
+  }
+  return true;
+}
+
+//  start_reader   : start the thread of a reader, confirming it has started if asked to
+//  confirm_reader : wait (a little) for the thread of a reader to start its read loop
+//
+bool RedisHub::start_reader(uint32_t token, bool confirm)
 {
   if (_readers_defer) return true;
 
@@ -340,17 +308,17 @@ bool RedisAdapter::start_reader(uint32_t token)
 
   if (info.thread.joinable()) return false;
 
-  //  info.start_mx / info.start_cv live in reader_info (in the _reader map) for as long
-  //  as the reader exists, which safely outlives this function whether or not the wait
-  //  below times out - this avoids a dangling reference to locals that a late-scheduled
-  //  thread might still touch after this function has already returned
-  unique_lock<mutex> lk(info.start_mx);  //  must be locked before cv.wait_for()
+  info.run = false;
 
   //  begin lambda  //////////////////////////////////////////////////
   info.thread = thread([this, &info]()
     {
       bool check_for_dollars = true;
 
+      //  blocking reads go on a dedicated connection so they never hold one of the
+      //  command pool's connections (and so never make writers wait for one)
+      RedisConnection::Blocker blk;
+
       {
         lock_guard<mutex> notify_lk(info.start_mx);
         info.run = true;
@@ -359,7 +327,11 @@ bool RedisAdapter::start_reader(uint32_t token)
 
       for (Streams out; info.run; out.clear())
       {
-        if (_redis.xreadMultiBlock(info.keyids.begin(), info.keyids.end(), _options.cxn.timeout, inserter(out, out.end())))
+        if ( ! blk && ! (blk = _redis.blocker(info.stop, _options.cxn.timeout)) && _redis.ping())
+        {
+          continue;   //  all cxn.blocking connections are leased, wait again
+        }
+        if (_redis.xreadMultiBlock(blk, info.keyids.begin(), info.keyids.end(), _options.cxn.timeout, inserter(out, out.end())))
         {
           for (auto& item : out)
           {
@@ -382,41 +354,61 @@ bool RedisAdapter::start_reader(uint32_t token)
 
             if (info.subs.count(item.first))
             {
+              //  the callbacks for a key may belong to several adapters, so they share the data
               auto split = split_key(item.first);
-              for (auto& func : info.subs.at(item.first))
+              if (split.first.empty()) { split = make_pair(item.first, item.first); }   //  generic key
+              auto data = make_shared<const ItemStream>(std::move(item.second));
+
+              for (auto& sub : info.subs.at(item.first))
               {
-                if (split.first.size())
-                {
-                  _replier_pool.job(item.first, [func, split = std::move(split), item = std::move(item)]()
-                    { func(split.first, split.second, item.second); }
-                  );
-                }
-                else
-                {
-                  _replier_pool.job(item.first, [func, item = std::move(item)]()
-                    { func(item.first, item.first, item.second); }
-                  );
-                }
+                _replier_pool.job(item.first, [func = sub.func, split, data]()
+                  { func(split.first, split.second, *data); }
+                );
               }
             }
           }
         }
+        else if (_redis.ping(info.stop))
+        {
+          //  the server is there, the read's node failed over or gave up the slot - lease a
+          //  connection to the node serving it now (after a pause, a failover takes a while)
+          this_thread::sleep_for(milliseconds(_options.backoff));
+        }
         else
         {
+          //  the server is gone, the reconnect restarts this reader with all the others
           syslog(LOG_ERR, "xreadMultiBlock returned false in reader");
           info.run = false;
+          reconnect(0);
         }
       }
     }
   );  //  end lambda  ////////////////////////////////////////////////
 
+  return ! confirm || confirm_reader(token);
+}
+
+bool RedisHub::confirm_reader(uint32_t token)
+{
+  if (_readers_defer) return true;
+
+  if (token == NO_TOKEN || _reader.count(token) == 0) return false;
+
+  reader_info& info = _reader.at(token);
+
+  //  info.start_mx / info.start_cv live in reader_info (in the _reader map) for as long
+  //  as the reader exists, which safely outlives this function whether or not the wait
+  //  below times out - this avoids a dangling reference to locals that a late-scheduled
+  //  thread might still touch after this function has already returned
+  unique_lock<mutex> lk(info.start_mx);
+
   //  wait until notified that thread is running (or timeout)
-  bool nto = info.start_cv.wait_for(lk, THREAD_START_CONFIRM) == cv_status::no_timeout;
+  bool nto = info.start_cv.wait_for(lk, THREAD_START_CONFIRM, [&]() { return info.run.load(); });
   if ( ! nto) syslog(LOG_WARNING, "start_reader timeout waiting for thread start");
   return nto;
 }
 
-bool RedisAdapter::stop_reader(uint32_t token)
+bool RedisHub::stop_reader(uint32_t token)
 {
   if (token == NO_TOKEN || _reader.count(token) == 0) return false;
 
@@ -424,7 +416,7 @@ bool RedisAdapter::stop_reader(uint32_t token)
   if ( ! info.thread.joinable()) return false;
 
   info.run = false;
-  Attrs attrs = default_field_attrs("");
+  Fields attrs = { { "_", "" } };
   //  poke the stop stream to unblock xreadMultiBlock - if it fails the reader
   //  will still exit after its timeout expires, do NOT call reconnect() here
   //  since stop_reader is called from within locked sections and spawning a
@@ -434,60 +426,1107 @@ bool RedisAdapter::stop_reader(uint32_t token)
   return true;
 }
 
-//  lazy reconnect - any _redis operation that passes zero into this function
-//    triggers a reconnect thread to launch (unless thread is already active)
-//    on failure thread lingers for 100ms to throttle network connection requests
-int32_t RedisAdapter::reconnect(int32_t result)
+//  stop all the readers at once - tell them all to stop and poke them all before joining
+//  any, so the time it takes does not grow with the number of readers
+void RedisHub::stop_readers()
 {
-  if (_shutdown) return result;
+  Fields attrs = { { "_", "" } };
+  for (auto& item : _reader)
+  {
+    if (item.second.thread.joinable()) { item.second.run = false; }
+  }
+  for (auto& item : _reader)
+  {
+    if (item.second.thread.joinable()) { _redis.xaddTrim(item.second.stop, "*", attrs.begin(), attrs.end(), 1); }
+  }
+  for (auto& item : _reader)
+  {
+    if (item.second.thread.joinable()) { item.second.thread.join(); }
+  }
+}
 
-  if (result == 0 && _connecting.exchange(true) == false)
+//  queue an op for the async thread, starting the thread on first use
+void RedisHub::async_queue(async_op op)
+{
   {
-    if (_reconnect_thd.joinable()) _reconnect_thd.join();
+    lock_guard<mutex> lk(_async_mtx);
+    if ( ! _async_thd.joinable()) { _async_thd = thread(&RedisHub::async_loop, this); }
+    _async_ops.push_back(std::move(op));
+  }
+  _async_cv.notify_one();
+}
 
-    _reconnect_thd = thread([this]()
-      {
-        if (_redis.connect(_options.cxn))
-        {
-          std::lock_guard<std::mutex> lk(_reader_mtx);
+//  everything queued while the previous batch was in flight goes out as the next batch,
+//  so the batches grow with the load and each op waits for at most one round trip
+void RedisHub::async_loop()
+{
+  vector<async_op> ops;
 
-          //  stop any waiting readers
-          for (const auto& rdr : _reader) { stop_reader(rdr.first); }
-          //  if any NO_TOKEN readers exist move them to valid tokens
-          if (_reader.count(NO_TOKEN))
-          {
-            //  move just the subs out (not the whole reader_info - it's non-movable
-            //  now that it holds a mutex/condition_variable) and erase NO_TOKEN first,
-            //  so that if reader_token() ever yields NO_TOKEN again below, _reader[token]
-            //  creates a fresh entry instead of aliasing the map we're iterating over
-            auto subs_map = std::move(_reader.at(NO_TOKEN).subs);
-            _reader.erase(NO_TOKEN);
-
-            for (const auto& subs : subs_map)
-            {
-              string key = subs.first;
-              uint32_t token = reader_token(key);
-              reader_info& info = _reader[token];
-              for (const auto& func : subs.second) { info.subs[key].push_back(func); }
-              info.keyids[key] = "$";
-              if (info.stop.empty())
-              {
-                auto part = split_key(key);
-                info.stop = build_key(part.second + ":" + STOP_STUB, part.first);
-                info.keyids[info.stop] = "$";
-              }
-            }
-          }
-          //  restart all readers
-          for (const auto& rdr : _reader) { start_reader(rdr.first); }
-        }
-        else
+  while (true)
+  {
+    {
+      unique_lock<mutex> lk(_async_mtx);
+      _async_cv.wait(lk, [this]() { return ! _async_run || _async_ops.size(); });
+      if (_async_ops.empty()) return;   //  stopped and drained
+      ops.swap(_async_ops);
+    }
+    async_batch(ops);
+    ops.clear();
+  }
+}
+
+//  run a batch of ops and return when all of them are done
+void RedisHub::async_batch(vector<async_op>& ops)
+{
+  //  a pipeline can only go to one node, so group the ops by node (keeping their order)
+  unordered_map<string, vector<async_op*>> nodes;
+  for (auto& op : ops)
+  {
+    string node = _redis.node(op.key, op.read);
+    if (node.empty()) node = to_string(_redis.keyslot(op.key));   //  no slot map, one pipeline per slot
+    nodes[node].push_back(&op);
+  }
+  if (nodes.empty()) return;
+
+  //  then run the pipelines for all the nodes at once, so the batch takes about as long
+  //  as the slowest node rather than the sum of them - the first one runs right here
+  auto here = nodes.begin();
+  size_t left = 0;
+  mutex mx;
+  condition_variable cv;
+  if (_options.fanout)
+  {
+    left = nodes.size() - 1;
+    for (auto it = std::next(here); it != nodes.end(); ++it)
+    {
+      auto& group = it->second;
+      _fanout_pool.job(it->first, [&]()
         {
-          this_thread::sleep_for(milliseconds(100));  //  throttle failures
-        }
-        _connecting = false;  //  thread is done
-      }
-    );
+          async_exec(group);
+          lock_guard<mutex> lk(mx);
+          if (--left == 0) cv.notify_one();
+        });
+    }
+    async_exec(here->second);
   }
-  return result;
+  else { for (auto& node : nodes) { async_exec(node.second); } }
+
+  unique_lock<mutex> lk(mx);
+  cv.wait(lk, [&]() { return left == 0; });
+}
+
+//  run one pipeline for ops that share a node, then hand each op its replies
+void RedisHub::async_exec(vector<async_op*>& ops)
+{
+  bool reads = all_of(ops.begin(), ops.end(), [](const async_op* op) { return op->read; });
+  bool ok = _redis.pipeline(ops.front()->key,
+    [&](Pipeline& pipe) { for (auto op : ops) { op->fill(pipe); } },
+    [&](QueuedReplies& replies)
+    {
+      size_t idx = 0;
+      for (auto op : ops) { op->done(&replies, idx); idx += op->count; }
+    },
+    reads
+  );
+  if ( ! ok)
+  {
+    for (auto op : ops) { op->done(nullptr, 0); }
+    reconnect(0);
+  }
+}
+
+//  add_watchdog     : start keeping a watchdog alive, replacing one of the same name
+//  remove_watchdog  : stop keeping a watchdog alive, false if it was not kept alive
+//  remove_watchdogs : stop keeping all the watchdogs of an adapter alive
+//
+void RedisHub::add_watchdog(watchdog dog)
+{
+  {
+    lock_guard<mutex> lk(_watchdog_mtx);
+    if ( ! _watchdog_thd.joinable()) { _watchdog_thd = thread(&RedisHub::watchdog_loop, this); }
+
+    auto same = [&](const watchdog& kept) { return kept.key == dog.key && kept.dogname == dog.dogname; };
+    _watchdogs.erase(remove_if(_watchdogs.begin(), _watchdogs.end(), same), _watchdogs.end());
+
+    dog.due = steady_clock::now();    //  pet it right away, then on the grid of its period
+    _watchdogs.push_back(std::move(dog));
+  }
+  _watchdog_cv.notify_one();
+}
+
+bool RedisHub::remove_watchdog(const string& key, const string& dogname)
+{
+  lock_guard<mutex> lk(_watchdog_mtx);
+  auto same = [&](const watchdog& kept) { return kept.key == key && kept.dogname == dogname; };
+  auto end = remove_if(_watchdogs.begin(), _watchdogs.end(), same);
+  bool found = end != _watchdogs.end();
+  _watchdogs.erase(end, _watchdogs.end());
+  return found;
+}
+
+void RedisHub::remove_watchdogs(const void* owner)
+{
+  lock_guard<mutex> lk(_watchdog_mtx);
+  auto mine = [owner](const watchdog& kept) { return kept.owner == owner; };
+  _watchdogs.erase(remove_if(_watchdogs.begin(), _watchdogs.end(), mine), _watchdogs.end());
+}
+
+//  each tick sends an HSET and an HEXPIRE for every dog that is due - the HSET brings back
+//  a dog that expired while the server was out of reach, which HEXPIRE alone cannot
+void RedisHub::watchdog_loop()
+{
+  unique_lock<mutex> lk(_watchdog_mtx);
+
+  while (_watchdog_run)
+  {
+    auto now = steady_clock::now();
+    auto next = now + seconds(1);   //  wake up now and then even without dogs
+    vector<async_op> ops;
+
+    for (auto& dog : _watchdogs)
+    {
+      if (dog.due <= now)
+      {
+        string key = dog.key, name = dog.dogname, sec = to_string(dog.expiration);
+        ops.push_back({ key, 2,
+          [=](Pipeline& pipe)
+          {
+            pipe.command("hset", key, name, RA_VERSION);
+            pipe.command("hexpire", key, sec, "fields", "1", name);
+          },
+          [](QueuedReplies* replies, size_t idx)
+          {
+            try { if (replies) replies->get<vector<long long>>(idx + 1); }
+            catch (const Error& e)
+            {
+              static bool squelch = false;   //  e.g. HEXPIRE needs redis-server 7.4.0, once is enough
+              if ( ! squelch) { syslog(LOG_ERR, "RedisHub::watchdog_loop %s", e.what()); squelch = true; }
+            }
+          }
+        });
+        //  the next multiple of the period, so dogs with the same period stay in step
+        dog.due = steady_clock::time_point((now.time_since_epoch() / dog.period + 1) * dog.period);
+      }
+      next = min(next, dog.due);
+    }
+
+    if (ops.size())
+    {
+      lk.unlock();
+      async_batch(ops);
+      lk.lock();
+      continue;
+    }
+    _watchdog_cv.wait_until(lk, next);
+  }
+}
+
+//  lazy reconnect - any _redis operation that passes zero into this function
+//    triggers a reconnect thread to launch (unless thread is already active)
+int32_t RedisHub::reconnect(int32_t result)
+{
+  if (_shutdown) return result;
+
+  if (result == 0 && _connecting.exchange(true) == false)
+  {
+    if (_reconnect_thd.joinable()) _reconnect_thd.join();
+
+    _reconnect_thd = thread(&RedisHub::reconnect_loop, this);
+  }
+  return result;
+}
+
+//  retry until connected - before each attempt wait a random time up to the backoff
+//  (full jitter), which starts at RA_Options::backoff and doubles up to backoffMax
+void RedisHub::reconnect_loop()
+{
+  connection_changed(false);
+
+  static thread_local mt19937 rng(random_device{}());
+  bool connected = false;
+
+  for (uint32_t attempt = 0; ! _shutdown; attempt++)
+  {
+    uint64_t backoff = min<uint64_t>((uint64_t)_options.backoff << min(attempt, 20u), _options.backoffMax);
+    auto delay = milliseconds(uniform_int_distribution<uint64_t>(0, backoff)(rng));
+    {
+      unique_lock<mutex> lk(_reconnect_mtx);
+      if (_reconnect_cv.wait_for(lk, delay, [this]() { return _shutdown.load(); })) break;
+    }
+    if (_redis.connect(_options.cxn))
+    {
+      restore_readers();
+
+      //  have the pub/sub listeners of every adapter resubscribe on the new connection
+      {
+        lock_guard<mutex> lk(_attach_mtx);
+        for (auto ra : _attached) { ra->listen_regroup(); }
+      }
+      //  still _connecting, so a callback that fails an operation does not start a thread
+      connection_changed(true);
+      connected = true;
+      break;
+    }
+  }
+  _connecting = false;  //  thread is done
+
+  //  replay the outage buffers - only now, since an add buffered while _connecting was
+  //  still set would otherwise wait for the next outage
+  if (connected)
+  {
+    lock_guard<mutex> lk(_attach_mtx);
+    for (auto ra : _attached) { ra->outage_replay(); }
+  }
+}
+
+//  restart every reader on the new connection - they are stopped, started and confirmed
+//  all at once, so this takes about as long for a thousand readers as for one
+void RedisHub::restore_readers()
+{
+  std::lock_guard<std::mutex> lk(_reader_mtx);
+
+  stop_readers();
+
+  //  if any NO_TOKEN readers exist move them to valid tokens
+  if (_reader.count(NO_TOKEN))
+  {
+    //  move just the subs out (not the whole reader_info - it's non-movable
+    //  now that it holds a mutex/condition_variable) and erase NO_TOKEN first,
+    //  so that if reader_token() ever yields NO_TOKEN again below, _reader[token]
+    //  creates a fresh entry instead of aliasing the map we're iterating over
+    auto subs_map = std::move(_reader.at(NO_TOKEN).subs);
+    _reader.erase(NO_TOKEN);
+
+    for (const auto& subs : subs_map)
+    {
+      string key = subs.first;
+      uint32_t token = reader_token(key);
+      reader_info& info = _reader[token];
+      for (const auto& sub : subs.second) { info.subs[key].push_back(sub); }
+      info.keyids[key] = "$";
+      if (info.stop.empty())
+      {
+        info.stop = stop_key(key);
+        info.keyids[info.stop] = "$";
+      }
+    }
+  }
+  for (const auto& rdr : _reader) { start_reader(rdr.first, false); }
+  for (const auto& rdr : _reader) { confirm_reader(rdr.first); }
+}
+
+//  set_connection_callback : set or clear (nullptr) the connection callback of an owner
+//  connection_changed      : call every connection callback
+//
+void RedisHub::set_connection_callback(const void* owner, ConnectionFn func)
+{
+  lock_guard<mutex> lk(_connection_mtx);
+  auto mine = [owner](const pair<const void*, ConnectionFn>& fn) { return fn.first == owner; };
+  _connection_fns.erase(remove_if(_connection_fns.begin(), _connection_fns.end(), mine), _connection_fns.end());
+  if (func) { _connection_fns.emplace_back(owner, func); }
+}
+
+void RedisHub::connection_changed(bool connected)
+{
+  lock_guard<mutex> lk(_connection_mtx);   //  held so an owner cannot go away mid call
+  for (const auto& fn : _connection_fns) { fn.second(connected); }
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  RedisAdapter : constructor
+//
+//    baseKey : base key of home device
+//    options : struct of default values, override using per-field initializer list
+//              e.g. { .user = "adinst", .password = "adinst" }
+//    hub     : hub to attach to (see RedisHub), a new one if nullptr
+//    dogname : name of a watchdog to keep alive, none if empty
+//    return  : RedisAdapter
+//
+RedisAdapter::RedisAdapter(const string& baseKey, const RA_Options& options) :
+  RedisAdapter(baseKey, make_shared<RedisHub>(options), options.dogname)
+{
+}
+
+RedisAdapter::RedisAdapter(const string& baseKey, shared_ptr<RedisHub> hub, const string& dogname) :
+  _hub(hub ? hub : make_shared<RedisHub>()), _redis(_hub->_redis), _base_key(baseKey)
+{
+  _watchdog_key = build_key("watchdog");
+  _listen_wake = build_key(WAKE_STUB);
+
+  _hub->attach(this);
+
+  if (dogname.size()) { startWatchdog(dogname, 1, 900); }   //  every 900ms set expire for 1000ms
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  ~RedisAdapter : destructor
+//
+//  The hub (and so the other adapters on it) carries on, so everything of this adapter's
+//  is taken off the hub and any of its callbacks already queued are waited for
+//
+RedisAdapter::~RedisAdapter()
+{
+  _outage_run = false;    //  a replay in progress stops after its current batch
+  _hub->set_connection_callback(this, nullptr);
+  _hub->remove_watchdogs(this);
+
+  _hub->detach(this);   //  no more listen_regroup() from the hub's reconnect
+
+  //  stop the pub/sub listeners - poke the live ones rather than wait out consume()
+  _listen_run = false;
+  vector<pair<string, string>> pokes;
+  {
+    lock_guard<mutex> lk(_listen_mtx);
+    for (const auto& shard : _listen_shards)
+      { if (shard.second.live) pokes.emplace_back(shard.first, shard.second.wake); }
+    _listen_cv.notify_all();
+  }
+  for (const auto& poke : pokes) { listen_poke(poke.first, poke.second); }
+  for (auto& shard : _listen_shards) { shard.second.thread.join(); }
+
+  //  wait for the async ops queued by this adapter - the hub completes them all
+  {
+    unique_lock<mutex> lk(_async_mtx);
+    _async_cv.wait(lk, [this]() { return _async_pending == 0; });
+  }
+
+  _hub->remove_readers(this);
+  if (_readers_defer) _hub->defer_readers(false);
+
+  _hub->_replier_pool.drain();
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  addSingleDouble : add a single data item of type double
+//
+//    subKey : sub key to add data to
+//    time   : time to add the data at
+//    data   : data to add
+//    trim   : number of items to trim the stream to
+//    return : time of the added data item if successful, zero on failure
+//
+RA_Time RedisAdapter::addSingleDouble(const string& subKey, double data, const RA_ArgsAdd& args)
+{
+  return add_single(build_key(subKey), args, default_field_attrs(data));
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  next_id   : allocate the ID of an add to a key
+//  forget_id : forget the last ID allocated for a key, e.g. when it is deleted
+//
+//    key    : the stream key
+//    time   : the time to add at, zero for host time
+//    return : the time as a Redis ID, moved to 1 ns after the last ID allocated for the key
+//             if it is not after it (counted by adjustedIDs) - unless it is a given time more
+//             than ID_TOLERANCE before it, which is left for redis to refuse
+//
+//  Redis refuses an ID that is not above the stream's last one, so without this two adds
+//  in the same nanosecond, or one after the host clock steps back, would fail - after a
+//  step back IDs advance by 1 ns per add until the clock catches up
+//
+//  The last IDs are bounded by MAX_LAST_IDS - when a new key would go past it, the keys not
+//  written in the last second (all of them if that is not enough) are forgotten, which only
+//  loses the adjustment for a clock step back of more than a second
+//
+string RedisAdapter::next_id(const string& key, RA_Time time)
+{
+  int64_t now = nanoseconds_since_epoch();
+  int64_t nanos = time.ok() ? time.value : now;
+  {
+    lock_guard<mutex> lk(_ids_mtx);
+    auto it = _last_ids.find(key);
+    if (it == _last_ids.end())
+    {
+      if (_last_ids.size() >= MAX_LAST_IDS)
+      {
+        for (auto old = _last_ids.begin(); old != _last_ids.end(); )
+          { old = old->second < now - 1000000000 ? _last_ids.erase(old) : std::next(old); }
+        if (_last_ids.size() >= MAX_LAST_IDS) { _last_ids.clear(); }
+      }
+      it = _last_ids.emplace(key, 0).first;
+    }
+    int64_t& last = it->second;
+    if (nanos <= last && ( ! time.ok() || last - nanos <= ID_TOLERANCE)) { nanos = last + 1; _ids_adjusted++; }
+    last = std::max(last, nanos);
+  }
+  return RA_Time(nanos).id();
+}
+
+void RedisAdapter::forget_id(const string& key)
+{
+  lock_guard<mutex> lk(_ids_mtx);
+  _last_ids.erase(key);
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  get_range : get raw items with XRANGE, or XREVRANGE (newest first) if reverse
+//
+//    key     : the stream key
+//    minID   : lowest id ("-" for the start of the stream)
+//    maxID   : highest id ("+" for the end of the stream)
+//    count   : max number of items to get (zero for all)
+//    reverse : true to get the newest count items
+//    raw     : where the items are appended
+//    return  : true if successful, false on failure
+//
+bool RedisAdapter::get_range(const string& key, const string& minID, const string& maxID,
+                             uint32_t count, bool reverse, ItemStream& raw)
+{
+  bool ok;
+  if (reverse)
+  {
+    ok = count ? _redis.xrevrange(key, maxID, minID, count, back_inserter(raw))
+               : _redis.xrevrange(key, maxID, minID, back_inserter(raw));
+  }
+  else
+  {
+    ok = count ? _redis.xrange(key, minID, maxID, count, back_inserter(raw))
+               : _redis.xrange(key, minID, maxID, back_inserter(raw));
+  }
+  return reconnect(ok);
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  add_single : add a single data item, through the key's outage buffer if it has one
+//
+//    key    : the stream key to add to
+//    args   : time and trim of the item
+//    attrs  : the item
+//    return : time of the added (or buffered) data item if successful, RA_NOT_CONNECTED on failure
+//
+RA_Time RedisAdapter::add_single(const string& key, const RA_ArgsAdd& args, const Fields& attrs)
+{
+  string id = next_id(key, args.time);
+
+  if (_outage_keys)
+  {
+    RA_Time buffered = outage_add(key, id, args, attrs, false);
+    if (buffered.value) return buffered;
+  }
+
+  string ret = args.trim ? _redis.xaddTrim(key, id, attrs.begin(), attrs.end(), args.trim, args.approximateTrim)
+                         : _redis.xadd(key, id, attrs.begin(), attrs.end());
+
+  if (reconnect(ret.size()) == 0)
+    { return _outage_keys ? outage_add(key, id, args, attrs, true) : RA_NOT_CONNECTED; }
+
+  return RA_Time(ret);
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  startWatchdog : add a watchdog that the hub keeps alive until stopWatchdog
+//
+//    dogname    : the name of the watchdog
+//    expiration : the number of seconds to expire the watchdog
+//    period     : milliseconds between refreshes, zero for 90% of expiration
+//    return     : true if successful, false if not successful
+//
+//  The hub sets the watchdog right away (and on every refresh), so this does not wait
+//  for the server
+//
+bool RedisAdapter::startWatchdog(const string& dogname, uint32_t expiration, uint32_t period)
+{
+  if (dogname.empty() || expiration == 0) return false;
+
+  if (period == 0) { period = expiration * 900; }
+
+  _hub->add_watchdog({ this, _watchdog_key, dogname, expiration, milliseconds(period), {} });
+  return true;
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  startOutageBuffer : keep the adds to a home stream key that fail for lack of a server
+//  stopOutageBuffer  : stop buffering a key
+//  outageStats       : the counters of a key's buffer
+//
+//    subKey  : sub key to buffer
+//    options : limits of the buffer and where to keep it
+//    return  : true if successful, false if not successful (or the key is already buffered)
+//
+//  Entries a file kept from an earlier run are replayed right away
+//
+bool RedisAdapter::startOutageBuffer(const string& subKey, const RA_BufferOptions& options)
+{
+  string key = build_key(subKey);
+
+  lock_guard<mutex> lk(_outage_mtx);
+  if (_outage.count(key)) return false;
+
+  auto ring = make_unique<RA_Buffer>(options.maxBytes, options.maxEntries, options.path);
+  if ( ! ring->ok()) return false;
+
+  outage_buffer& buf = _outage[key];
+  buf.ring = std::move(ring);
+  buf.batch = max(options.batch, 1u);
+  buf.gen = ++_outage_gen;
+  _outage_keys++;
+
+  if (buf.ring->entries() && ! _hub->_connecting) { outage_batch(key, buf); }
+  return true;
+}
+
+bool RedisAdapter::stopOutageBuffer(const string& subKey)
+{
+  lock_guard<mutex> lk(_outage_mtx);
+  if (_outage.erase(build_key(subKey)) == 0) return false;
+  _outage_keys--;
+  return true;
+}
+
+RA_BufferStats RedisAdapter::outageStats(const string& subKey)
+{
+  lock_guard<mutex> lk(_outage_mtx);
+  auto it = _outage.find(build_key(subKey));
+  if (it == _outage.end()) return {};
+
+  RA_BufferStats stats = it->second.stats;
+  stats.entries = it->second.ring->entries();
+  stats.bytes = it->second.ring->bytes();
+  return stats;
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  setDeferReaders : defer or un-defer addition and removal of readers
+//                    - deferring cancels all reads and stops all reader threads until un-defer
+//                    - un-deferring starts all reader threads
+//                    this prevents redundant thread destruction/creation and is
+//                    the preferred way to add/remove multiple readers at one time
+//
+//    defer   : whether to defer or un-defer addition and removal of readers
+//    return  : true on success, false on failure
+//
+bool RedisAdapter::setDeferReaders(bool defer)
+{
+  //  the hub's readers are shared, so the hub counts the adapters deferring them
+  if (_readers_defer.exchange(defer) == defer) return true;
+
+  return _hub->defer_readers(defer);
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  addGenericReader : add a reader for a key that does NOT follow RedisAdapter schema
+//
+//    key     : the key to add (must NOT be a RedisAdapter schema key)
+//    func    : function to call when data is read - data will be RedisAdapter::Attrs
+//    return  : true if reader started, false if reader failed to start
+//
+bool RedisAdapter::addGenericReader(const string& key, ReaderSubFn<Attrs> func)
+{
+  if (RedisHub::split_key(key).first.size()) return false;  //  reject if basekey found
+
+  return _hub->add_reader(this, key, make_reader_callback(func));
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  removeGenericReader : remove all readers for a key that does NOT follow RedisAdapter schema
+//
+//    key     : the key to remove (must NOT be a RedisAdapter schema key)
+//    return  : true if reader started, false if reader failed to start
+//
+bool RedisAdapter::removeGenericReader(const string& key)
+{
+  if (RedisHub::split_key(key).first.size()) return false;  //  reject if basekey found
+
+  return _hub->remove_reader(this, key);
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  subscribe   : subscribe for messages on a single channel
+//  psubscribe  : pattern subscribe for messages on a set of channels matching a pattern
+//  unsubscribe : unsubscribe a single channel or pattern
+//
+//    baseKey : the base key to construct the channel from
+//    subKey  : the sub key to construct the channel from
+//    func    : the function to call when message received on this channel
+//    return  : true on success, false on failure
+//
+//  Subscriptions are remembered by the adapter, so they are restored whenever the
+//  listener has to build a new subscriber connection (e.g. after a reconnect)
+//
+bool RedisAdapter::subscribe(const string& subKey, ListenSubFn func, const string& baseKey)
+{
+  return func && listen_helper(listen_op::sub, build_key(subKey, baseKey), func);
+}
+
+bool RedisAdapter::psubscribe(const string& subKey, ListenSubFn func, const string& baseKey)
+{
+  return func && listen_helper(listen_op::psub, build_key(subKey, baseKey), func);
+}
+
+bool RedisAdapter::unsubscribe(const string& subKey, const string& baseKey)
+{
+  return listen_helper(listen_op::unsub, build_key(subKey, baseKey), nullptr);
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  Private methods
+//
+string RedisAdapter::build_key(const string& subKey, const string& baseKey) const
+{
+  //  surround base key with {} to locate keys with same base key in same cluster slot
+  //  this mitgates CROSSSLOT errors for copyKey and renameKey but also puts all keys
+  //  for a base key onto the same reader thread (this could be mitigated with an additional
+  //  load balancing strategy of mutiple threads per slot if necessary)
+  //  NOTE - none of this has ANY effect for single instance (non-cluster) Redis servers
+  return "{" + (baseKey.size() ? baseKey : _base_key) + "}" + (subKey.size() ? ":" + subKey : "");
+}
+
+bool RedisAdapter::copy(const string& srcSubKey, const string& dstSubKey, const string& baseKey)
+{
+  string srcKey = build_key(srcSubKey, baseKey);
+  string dstKey = build_key(dstSubKey);
+
+  int32_t ret = _redis.copy(srcKey, dstKey);
+
+  //  WARNING - this cross-slot copy brings ALL the data from srcKey to the client computer for
+  //            manual re-add to dstKey - this is potentially network, memory and cpu intensive!
+  if (ret == -2 && _redis.exists(dstKey) == 0)
+  {
+    ItemStream raw;
+    if (_redis.xrange(srcKey, "-", "+", back_inserter(raw)))
+    {
+      string id;
+      for (auto& it : raw) { id = _redis.xadd(dstKey, it.first, it.second.begin(), it.second.end()); }
+      ret = id.size();
+    }
+  }
+  reconnect(ret != -1);   //  if ret == -1, pass 0 to reconnect
+  return ret > 0;
+}
+
+bool RedisAdapter::add_reader_helper(const string& baseKey, const string& subKey, reader_sub_fn func, const void* tag)
+{
+  return _hub->add_reader(this, build_key(subKey, baseKey), func, tag);
+}
+
+bool RedisAdapter::remove_reader_helper(const string& baseKey, const string& subKey, const void* tag)
+{
+  return _hub->remove_reader(this, build_key(subKey, baseKey), tag);
+}
+
+bool RedisAdapter::listen_helper(listen_op op, const string& chan, ListenSubFn func)
+{
+  //  find the shard before taking the lock, it may refresh the slot map from the cluster
+  string home = op == listen_op::sub ? _redis.shard(chan) : string();
+
+  vector<pair<string, string>> pokes;
+  {
+    lock_guard<mutex> lk(_listen_mtx);
+
+    auto queue = [&](listen_op op, const string& node)
+      { if (listen_queue(op, chan, node)) pokes.emplace_back(node, _listen_shards.at(node).wake); };
+
+    switch (op)
+    {
+      case listen_op::sub:
+        if (_listen_chans[chan].empty())
+        {
+          _listen_where[chan] = home;
+          queue(op, home);
+        }
+        _listen_chans[chan].push_back(func);
+        break;
+
+      case listen_op::psub:
+        if (_listen_pats[chan].empty()) { queue(op, ""); }
+        _listen_pats[chan].push_back(func);
+        break;
+
+      default:   //  unsubscribe removes both the channel and the pattern of that name
+      {
+        bool found = false;
+        if (_listen_chans.erase(chan))
+        {
+          string node = _listen_where[chan];
+          _listen_where.erase(chan);
+          queue(listen_op::unsub, node);
+          found = true;
+        }
+        if (_listen_pats.erase(chan))
+        {
+          queue(listen_op::punsub, "");
+          found = true;
+        }
+        if ( ! found) return false;   //  nothing was subscribed
+        break;
+      }
+    }
+  }
+  //  poke the listener out of consume() so it applies the change now - if this fails the
+  //  listener still applies it when consume() times out, do NOT call reconnect() here
+  for (const auto& poke : pokes) { listen_poke(poke.first, poke.second); }
+  return true;
+}
+
+//  queue a subscription change for the shard serving node, starting its listener if
+//  needed - must hold _listen_mtx, returns true if the listener needs to be poked
+bool RedisAdapter::listen_queue(listen_op op, const string& chan, const string& node)
+{
+  listen_shard& shard = _listen_shards[node];
+
+  if ( ! shard.thread.joinable()) { shard.thread = thread(&RedisAdapter::listen_loop, this, node); }
+
+  //  a listener without a subscriber builds one from the tables, so just tell it to
+  if ( ! shard.live)
+  {
+    shard.renew = true;
+    _listen_cv.notify_all();
+    return false;
+  }
+  shard.todo.emplace_back(op, chan);
+  return true;
+}
+
+//  after a reconnect the slots may have moved, so re-home every channel on the shard
+//  that now serves it and have every listener resubscribe on the new connection
+void RedisAdapter::listen_regroup()
+{
+  //  find the shards outside the lock, refreshing the slot map takes round trips to the cluster
+  vector<pair<string, string>> homes;
+  {
+    lock_guard<mutex> lk(_listen_mtx);
+    for (const auto& where : _listen_where) { homes.emplace_back(where.first, string()); }
+  }
+  for (auto& home : homes) { home.second = _redis.shard(home.first); }
+
+  vector<pair<string, string>> pokes;
+  {
+    lock_guard<mutex> lk(_listen_mtx);
+
+    for (const auto& home : homes)
+    {
+      auto where = _listen_where.find(home.first);
+      if (where == _listen_where.end()) continue;   //  unsubscribed meanwhile
+      where->second = home.second;
+      listen_shard& shard = _listen_shards[where->second];
+      if ( ! shard.thread.joinable()) { shard.thread = thread(&RedisAdapter::listen_loop, this, where->second); }
+    }
+    for (auto& shard : _listen_shards)
+    {
+      shard.second.renew = true;
+      if (shard.second.live) { pokes.emplace_back(shard.first, shard.second.wake); }
+    }
+    _listen_cv.notify_all();
+  }
+  for (const auto& poke : pokes) { listen_poke(poke.first, poke.second); }
+}
+
+void RedisAdapter::listen_poke(const string& node, const string& wake)
+{
+  if (node.size()) { _redis.spublish(wake, ""); }
+  else             { _redis.publish(wake, ""); }
+}
+
+void RedisAdapter::listen_loop(string node)
+{
+  unique_ptr<Subscriber> sub;
+  string wake;
+
+  while (_listen_run)
+  {
+    try
+    {
+      vector<pair<listen_op, string>> todo;
+      {
+        unique_lock<mutex> lk(_listen_mtx);
+        listen_shard& shard = _listen_shards.at(node);
+
+        if (shard.renew || ! sub)
+        {
+          //  a new subscriber gets everything this shard serves, so anything queued is covered
+          shard.renew = false;
+          shard.todo.clear();
+          for (const auto& where : _listen_where)
+            { if (where.second == node) todo.emplace_back(listen_op::sub, where.first); }
+          if (node.empty())
+            { for (const auto& pat : _listen_pats) todo.emplace_back(listen_op::psub, pat.first); }
+
+          sub.reset();
+          shard.live = false;
+
+          if (todo.empty())   //  nothing to serve, so no connection until there is
+          {
+            _listen_cv.wait(lk, [&]() { return ! _listen_run || shard.renew; });
+            continue;
+          }
+          //  the wake channel has to be served by this shard - for sharded pub/sub that
+          //  means it must hash to the same slot as a channel this shard subscribes to
+          shard.wake = wake = node.empty() ? _listen_wake : todo.front().second + ":" + WAKE_STUB;
+          todo.emplace_back(listen_op::sub, wake);
+        }
+        else { todo.swap(shard.todo); }
+      }
+
+      if ( ! sub)
+      {
+        sub = node.empty() ? _redis.subscriber() : _redis.ssubscriber(wake);
+        if ( ! sub)
+        {
+          reconnect(0);
+          this_thread::sleep_for(milliseconds(100));  //  throttle failures
+          continue;
+        }
+        sub->on_message([this, wake](string chan, string msg)
+          {
+            if (chan == wake) return;
+            vector<ListenSubFn> funcs;
+            {
+              lock_guard<mutex> lk(_listen_mtx);
+              auto it = _listen_chans.find(chan);
+              if (it != _listen_chans.end()) { funcs = it->second; }
+            }
+            listen_dispatch(chan, funcs, msg);
+          }
+        );
+        sub->on_pmessage([this](string pat, string chan, string msg)
+          {
+            vector<ListenSubFn> funcs;
+            {
+              lock_guard<mutex> lk(_listen_mtx);
+              auto it = _listen_pats.find(pat);
+              if (it != _listen_pats.end()) { funcs = it->second; }
+            }
+            listen_dispatch(chan, funcs, msg);
+          }
+        );
+      }
+
+      for (const auto& item : todo)
+      {
+        switch (item.first)
+        {
+          case listen_op::sub:    node.size() ? sub->ssubscribe(item.second) : sub->subscribe(item.second); break;
+          case listen_op::unsub:  node.size() ? sub->sunsubscribe(item.second) : sub->unsubscribe(item.second); break;
+          case listen_op::psub:   sub->psubscribe(item.second);   break;
+          case listen_op::punsub: sub->punsubscribe(item.second); break;
+        }
+      }
+
+      {
+        lock_guard<mutex> lk(_listen_mtx);
+        listen_shard& shard = _listen_shards.at(node);
+        shard.live = true;
+        if (shard.renew || shard.todo.size()) continue;   //  changed while we were subscribing
+      }
+
+      sub->consume();   //  returns after one message, throws TimeoutError when idle
+    }
+    catch (const TimeoutError&) {}
+    catch (const Error& e)
+    {
+      syslog(LOG_ERR, "RedisAdapter::%s %s", __func__, e.what());
+      sub.reset();      //  resubscribe everything on a new connection
+      reconnect(0);
+      this_thread::sleep_for(milliseconds(100));  //  throttle failures
+    }
+  }
+}
+
+void RedisAdapter::listen_dispatch(const string& chan, const vector<ListenSubFn>& funcs, const string& msg)
+{
+  auto split = RedisHub::split_key(chan);
+  for (const auto& func : funcs)
+  {
+    if (split.first.size())
+    {
+      _hub->_replier_pool.job(chan, [func, split, msg]() { func(split.first, split.second, msg); });
+    }
+    else
+    {
+      _hub->_replier_pool.job(chan, [func, chan, msg]() { func(chan, chan, msg); });
+    }
+  }
+}
+
+//  add_async_single : queue an XADD (with trim) of one item
+//  add_async_multi  : queue XADDs of several items and one XTRIM after them
+//
+//  these build the same commands as addSingleValue and addValues, so the
+//  results (and RA_NOT_CONNECTED on failure) match the synchronous methods
+//
+RA_Future<RA_Time> RedisAdapter::add_async_single(const string& key, const RA_ArgsAdd& args, Fields attrs)
+{
+  RA_Promise<RA_Time> promise;
+  string id = next_id(key, args.time);
+  uint32_t trim = args.trim;
+  bool apx = args.approximateTrim;
+
+  async_queue({ key, 1,
+    [=](Pipeline& pipe)
+    {
+      if (trim) { pipe.xadd(key, id, attrs.begin(), attrs.end(), trim, apx); }
+      else      { pipe.xadd(key, id, attrs.begin(), attrs.end()); }
+    },
+    [=](QueuedReplies* replies, size_t idx)
+    {
+      RA_Time ret = RA_NOT_CONNECTED;
+      if (replies)
+      {
+        try { ret = RA_Time(replies->get<string>(idx)); }
+        catch (const Error& e) { syslog(LOG_ERR, "RedisAdapter::%s %s", __func__, e.what()); }
+      }
+      promise.set(ret);
+    }
+  });
+  return promise.future();
+}
+
+RA_Future<vector<RA_Time>> RedisAdapter::add_async_multi(const string& key, vector<Item> items, uint32_t trim)
+{
+  RA_Promise<vector<RA_Time>> promise;
+  auto shared = make_shared<vector<Item>>(std::move(items));   //  one copy for both closures
+  trim = trim ? max(trim, (uint32_t)shared->size()) : 0;
+
+  async_queue({ key, shared->size() + (trim ? 1 : 0),
+    [=](Pipeline& pipe)
+    {
+      for (const auto& item : *shared) { pipe.xadd(key, item.first, item.second.begin(), item.second.end()); }
+      if (trim) { pipe.xtrim(key, trim); }
+    },
+    [=](QueuedReplies* replies, size_t idx)
+    {
+      vector<RA_Time> ret;
+      for (size_t i = 0; replies && i < shared->size(); i++)
+      {
+        try { ret.push_back(RA_Time(replies->get<string>(idx + i))); }
+        catch (const Error& e) { syslog(LOG_ERR, "RedisAdapter::%s %s", __func__, e.what()); }
+      }
+      promise.set(std::move(ret));
+    }
+  });
+  return promise.future();
+}
+
+//  outage_add : put an add in the key's outage buffer
+//
+//    key    : the stream key
+//    id     : the ID the add was (or would be) made with
+//    args   : time and trim of the add
+//    attrs  : the item
+//    failed : true if the add failed, false to ask if it must be buffered before trying it
+//    return : the time of the buffered entry, RA_NOT_CONNECTED if it could not be buffered,
+//             or zero if it need not be (not failed, nothing waiting, and not reconnecting)
+//
+RA_Time RedisAdapter::outage_add(const string& key, const string& id, const RA_ArgsAdd& args,
+                                 const Fields& attrs, bool failed)
+{
+  lock_guard<mutex> lk(_outage_mtx);
+  auto it = _outage.find(key);
+  if (it == _outage.end()) return failed ? RA_NOT_CONNECTED : RA_Time();
+
+  outage_buffer& buf = it->second;
+  if ( ! failed && buf.ring->entries() == 0 && ! _hub->_connecting) return RA_Time();
+
+  //  redis would refuse it on replay, so refuse it now
+  RA_Time time(id);
+  if (time.value <= buf.ring->last()) { buf.stats.dropped++; return RA_NOT_CONNECTED; }
+
+  if ( ! buf.ring->push({ time.value, args.trim, args.approximateTrim, attrs }, buf.stats.dropped))
+    { return RA_NOT_CONNECTED; }
+  buf.stats.buffered++;
+
+  //  the hub replays every buffer once it has reconnected - this catches the rest, e.g.
+  //  an add that failed without losing the server or came just after a replay finished
+  if ( ! buf.replaying && ! _hub->_connecting) { outage_batch(key, buf); }
+  return time;
+}
+
+//  outage_replay : replay every outage buffer that is not replaying already
+//  outage_batch  : queue the next batch of a buffer's replay, under _outage_mtx
+//
+//  a batch pops its entries when it is done and queues the next, until the buffer is
+//  empty - if the server is lost again the entries stay for the next reconnect, and an
+//  entry redis refuses (e.g. an add that made it before the connection dropped) is dropped
+//
+void RedisAdapter::outage_replay()
+{
+  lock_guard<mutex> lk(_outage_mtx);
+  for (auto& buf : _outage) { if ( ! buf.second.replaying) outage_batch(buf.first, buf.second); }
+}
+
+void RedisAdapter::outage_batch(const string& key, outage_buffer& buf)
+{
+  auto entries = make_shared<vector<RA_Buffer::Entry>>();
+  uint64_t first = buf.ring->peek(buf.batch, *entries);
+
+  buf.replaying = entries->size() && _outage_run;
+  if ( ! buf.replaying) return;
+
+  uint64_t gen = buf.gen;
+  async_queue({ key, entries->size(),
+    [=](Pipeline& pipe)
+    {
+      for (const auto& entry : *entries)
+      {
+        auto id = RA_Time(entry.time).chars();
+        if (entry.trim) { pipe.xadd(key, id, entry.attrs.begin(), entry.attrs.end(), entry.trim, entry.approximateTrim); }
+        else            { pipe.xadd(key, id, entry.attrs.begin(), entry.attrs.end()); }
+      }
+    },
+    [this, key, entries, first, gen](QueuedReplies* replies, size_t idx)
+    {
+      lock_guard<mutex> lk(_outage_mtx);
+      auto it = _outage.find(key);
+      if (it == _outage.end() || it->second.gen != gen) return;   //  stopped meanwhile
+
+      outage_buffer& buf = it->second;
+      if ( ! replies) { buf.replaying = false; return; }
+
+      uint64_t refused = 0;
+      for (size_t i = 0; i < entries->size(); i++)
+      {
+        try { replies->get<string>(idx + i); buf.stats.replayed++; }
+        catch (const Error& e)
+          { if (refused++ == 0) syslog(LOG_ERR, "RedisAdapter::outage_batch %s", e.what()); }
+      }
+      buf.stats.dropped += refused;
+      buf.ring->pop(first + entries->size());
+      outage_batch(key, buf);
+    }
+  });
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  delAsync : delete a home stream key asynchronously
+//
+//    subKey : the sub key to delete
+//    return : future for true if successful (deleted or not found), false on failure
+//
+RA_Future<bool> RedisAdapter::delAsync(const string& subKey)
+{
+  RA_Promise<bool> promise;
+  string key = build_key(subKey);
+  forget_id(key);
+
+  async_queue({ key, 1,
+    [=](Pipeline& pipe) { pipe.del(key); },
+    [=](QueuedReplies* replies, size_t idx)
+    {
+      bool ret = false;
+      if (replies)
+      {
+        try { replies->get<long long>(idx); ret = true; }
+        catch (const Error& e) { syslog(LOG_ERR, "RedisAdapter::%s %s", __func__, e.what()); }
+      }
+      promise.set(ret);
+    }
+  });
+  return promise.future();
+}
+
+//  queue an op on the hub, counting it until it is done since it may call back into
+//  this adapter (e.g. to convert the items of a get)
+void RedisAdapter::async_queue(async_op op)
+{
+  {
+    lock_guard<mutex> lk(_async_mtx);
+    _async_pending++;
+  }
+  op.done = [this, done = std::move(op.done)](QueuedReplies* replies, size_t idx)
+    {
+      done(replies, idx);
+      lock_guard<mutex> lk(_async_mtx);
+      if (--_async_pending == 0) _async_cv.notify_all();
+    };
+  _hub->async_queue(std::move(op));
 }
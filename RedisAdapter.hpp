@@ -1,7 +1,7 @@
 //
 //  RedisAdapter.hpp
 //
-//  This file contains the RedisAdapter class definition
+//  This file contains the RedisHub and RedisAdapter class definitions
 
 #pragma once
 
@@ -10,11 +10,16 @@
 using RedisAdapter = MockRedisAdapter;
 #else // defined(MOCK_REDIS_ADAPTER)
 #include "RedisConnection.hpp"
+#include "RedisFuture.hpp"
+#include "RedisBuffer.hpp"
 #include "ThreadPool.hpp"
 #include <thread>
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <string_view>
+#include <type_traits>
+#include <memory_resource>
 
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
 //  define RA_VERSION
@@ -41,7 +46,11 @@ using RedisAdapter = MockRedisAdapter;
 struct RA_Time
 {
   RA_Time(int64_t nanos = 0) : value(nanos) {}
-  RA_Time(const std::string& id);
+  RA_Time(std::string_view id);
+  RA_Time(const std::string& id) : RA_Time(std::string_view(id)) {}
+  //  any char pointer or literal, as a template so a literal 0 still means nanoseconds
+  template<typename C, typename = std::enable_if_t<std::is_same<C, char>::value>>
+  RA_Time(const C* id) : RA_Time(std::string_view(id)) {}
 
   bool ok() const { return value > 0; }
 
@@ -50,6 +59,17 @@ struct RA_Time
 
   uint32_t err() const { return ok() ? 0 : -value; }
 
+  //  an ID formatted into a buffer of its own, usable as a string_view while it lives -
+  //  long enough for any ID ("9223372036854-775807")
+  struct Chars
+  {
+    char data[24];
+    uint8_t size;
+
+    operator std::string_view() const { return { data, size }; }
+  };
+
+  Chars chars() const;            //  the ID without allocating
   std::string id() const;
   std::string id_or_now() const;
 
@@ -97,6 +117,240 @@ struct RA_Options
   std::string dogname;
   uint16_t workers = 1;
   uint16_t readers = 1;
+  uint16_t fanout = 4;    //  threads running async pipelines to different cluster nodes at once
+  uint32_t backoff = 100;       //  milliseconds before the first reconnect attempt, at most
+  uint32_t backoffMax = 10000;  //  limit of the backoff, which doubles for each failed attempt
+};
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  struct RA_BufferOptions, struct RA_BufferStats
+//
+//  The limits of an outage buffer and its counters, see RedisAdapter::startOutageBuffer
+//
+struct RA_BufferOptions
+{
+  size_t maxBytes = 1 << 20;    //  bytes of the ring, the oldest entries are dropped past it
+  uint32_t maxEntries = 0;      //  limit of the number of entries, zero for none
+  std::string path;             //  file to keep the ring in, memory if empty
+  uint32_t batch = 100;         //  entries per replay pipeline
+};
+
+struct RA_BufferStats
+{
+  uint64_t buffered = 0;        //  entries put in the buffer
+  uint64_t replayed = 0;        //  entries added to the stream by replay
+  uint64_t dropped = 0;         //  entries dropped for the limits, out of order or rejected by replay
+  size_t entries = 0;           //  entries in the buffer now
+  size_t bytes = 0;             //  bytes of those entries
+};
+
+class RedisAdapter;
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  class RedisHub
+//
+//  The connection pools, stream readers, worker threads, async pipelines and reconnect
+//  behind a RedisAdapter - each adapter makes its own hub unless it is given one, so a
+//  process hosting many adapters (e.g. one per device) can attach them all to one hub
+//
+//    auto hub = std::make_shared<RedisHub>(options);
+//    RedisAdapter bpm01("BPM01", hub), bpm02("BPM02", hub);
+//
+//  Adapters on a hub share its connections and its reader threads (readers for keys in
+//  the same slot, which on a single server is all of them, are served by the same XREAD
+//  whichever adapter added them), its worker, fanout and async threads and its watchdog
+//  thread - an attached adapter only has threads of its own for pub/sub subscriptions
+//
+class RedisHub
+{
+public:
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Construction / Destruction
+  //
+  //    options : as for RedisAdapter, except dogname which is per adapter
+  //
+  //  Every attached adapter holds the hub, so it outlives them
+  //
+  RedisHub(const RA_Options& options = {});
+
+  RedisHub(const RedisHub& hub) = delete;               //  copy construction not allowed
+  RedisHub& operator=(const RedisHub& hub) = delete;    //  assignment not allowed
+
+  ~RedisHub();
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  connected : test if server is connected and responsive
+  //  adapters  : number of adapters attached to this hub
+  //
+  bool connected() { return reconnect(_redis.ping()); }
+
+  size_t adapters();
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  ConnectionFn          : callback function type for connection state changes
+  //  setConnectionCallback : set (or clear with nullptr) the callback for this hub
+  //
+  //    connected : false when the hub starts reconnecting, true once it has reconnected
+  //                and restored the readers and subscriptions
+  //
+  //  Callbacks run on the reconnect thread, so keep them short (and do not set callbacks
+  //  from one)
+  //
+  using ConnectionFn = std::function<void(bool connected)>;
+
+  void setConnectionCallback(ConnectionFn func) { set_connection_callback(this, func); }
+
+private:
+  friend class RedisAdapter;
+
+  using Fields = RA_Fields;
+  using Item = std::pair<std::string, Fields>;
+  using ItemStream = std::vector<Item>;
+  using Streams = std::unordered_map<std::string, ItemStream>;
+
+  const std::string STOP_STUB = "<$-STOP-$>";   //  stream stub to stop reader thread
+
+  static std::pair<std::string, std::string> split_key(const std::string& key);
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Redis server
+  //
+  RA_Options _options;
+  RedisConnection _redis;
+
+  //  a failed operation passes zero to reconnect(), which starts the reconnect thread if
+  //  it is not running - the thread retries with exponential backoff and full jitter, so
+  //  many clients that lost the same server do not come back in lockstep
+  int32_t reconnect(int32_t result);
+  void reconnect_loop();
+  void restore_readers();
+
+  std::atomic_bool _connecting{false};
+  std::thread _reconnect_thd;
+  std::atomic<bool> _shutdown{false};
+  std::mutex _reconnect_mtx;
+  std::condition_variable _reconnect_cv;
+
+  void set_connection_callback(const void* owner, ConnectionFn func);
+  void connection_changed(bool connected);
+
+  std::mutex _connection_mtx;
+  std::vector<std::pair<const void*, ConnectionFn>> _connection_fns;
+
+  //  attached adapters, whose pub/sub listeners resubscribe after a reconnect
+  void attach(RedisAdapter* ra);
+  void detach(RedisAdapter* ra);
+
+  std::mutex _attach_mtx;
+  std::vector<RedisAdapter*> _attached;
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Stream readers
+  //
+  //  Every callback is tagged with the adapter that added it (owner), so an adapter only
+  //  removes its own callbacks from a key other adapters may be reading too - and with the
+  //  tag it was added with, if any, so one user of an adapter can remove just its own
+  //
+  using reader_sub_fn = std::function<void(const std::string& baseKey, const std::string& subKey, const ItemStream& data)>;
+
+  struct reader_sub
+  {
+    const void* owner;
+    const void* tag;
+    reader_sub_fn func;
+  };
+
+  uint32_t reader_token(const std::string& key);
+  std::string stop_key(const std::string& key) const;
+
+  bool add_reader(const void* owner, const std::string& key, reader_sub_fn func, const void* tag = nullptr);
+  bool remove_reader(const void* owner, const std::string& key, const void* tag = nullptr);
+  bool unlink_reader(const void* owner, const std::string& key, const void* tag);
+  void remove_readers(const void* owner);
+  bool defer_readers(bool defer);
+
+  bool start_reader(uint32_t token, bool confirm = true);
+  bool confirm_reader(uint32_t token);
+  bool stop_reader(uint32_t token);
+  void stop_readers();
+
+  uint32_t _readers_defer = 0;    //  number of adapters deferring readers, under _reader_mtx
+
+  std::mutex _reader_mtx;
+
+  struct reader_info
+  {
+    std::thread thread;
+    std::unordered_map<std::string, std::vector<reader_sub>> subs;
+    std::unordered_map<std::string, std::string> keyids;
+    std::string stop;
+    std::atomic<bool> run = false;
+
+    //  used by start_reader() to confirm the reader thread has begun its read loop -
+    //  these live here (in the _reader map) rather than as locals in start_reader()
+    //  so their lifetime safely covers the reader thread's lifetime, not just one call
+    std::mutex start_mx;
+    std::condition_variable start_cv;
+  };
+  std::unordered_map<uint32_t, reader_info> _reader;
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Asynchronous operations
+  //
+  //  An async_op queues its commands on a pipeline and is called back with the replies
+  //  (nullptr if the pipeline failed) and the index of its first reply - the async thread
+  //  drains the queue, groups the ops by node and runs one pipeline per node
+  //
+  struct async_op
+  {
+    std::string key;                                            //  picks the node
+    size_t count;                                               //  commands queued by fill
+    std::function<void(swr::Pipeline&)> fill;
+    std::function<void(swr::QueuedReplies*, size_t)> done;
+    bool read = false;                                          //  only reads, may go to a replica
+  };
+
+  void async_queue(async_op op);
+  void async_loop();
+  void async_batch(std::vector<async_op>& ops);
+  void async_exec(std::vector<async_op*>& ops);
+
+  std::mutex _async_mtx;
+  std::condition_variable _async_cv;
+  std::vector<async_op> _async_ops;
+  std::thread _async_thd;
+  bool _async_run = true;
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Watchdogs
+  //
+  //  One thread keeps every watchdog on the hub alive - dogs are due on a grid of their
+  //  period, so dogs with the same period come due together, and everything due at a
+  //  tick goes out as one async batch (a pipeline per node, all nodes at once)
+  //
+  struct watchdog
+  {
+    const void* owner;                                  //  the adapter that started it
+    std::string key;                                    //  the adapter's watchdog hash
+    std::string dogname;                                //  the field in the hash
+    uint32_t expiration;                                //  seconds
+    std::chrono::milliseconds period;
+    std::chrono::steady_clock::time_point due;
+  };
+
+  void add_watchdog(watchdog dog);
+  bool remove_watchdog(const std::string& key, const std::string& dogname);
+  void remove_watchdogs(const void* owner);
+  void watchdog_loop();
+
+  std::mutex _watchdog_mtx;
+  std::condition_variable _watchdog_cv;
+  std::vector<watchdog> _watchdogs;
+  std::thread _watchdog_thd;
+  bool _watchdog_run = true;
+
+  ThreadPool _replier_pool;
+  ThreadPool _fanout_pool;   //  runs the async pipelines for different nodes concurrently
 };
 
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -120,11 +374,20 @@ public:
   template<typename T> using TimeVal = std::pair<RA_Time, T>;         //  analagous to Item
   template<typename T> using TimeValList = std::vector<TimeVal<T>>;   //  analagous to ItemStream
 
+  template<typename T> using PmrTimeValList = std::pmr::vector<TimeVal<T>>;   //  from a memory_resource
+
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  Construction / Destruction
   //
+  //    baseKey : base key of home device
+  //    options : options for the adapter and the hub it makes for itself
+  //    hub     : hub to attach to, shared with other adapters (see RedisHub)
+  //    dogname : name of a watchdog to keep alive, none if empty
+  //
   RedisAdapter(const std::string& baseKey, const RA_Options& options = {});
 
+  RedisAdapter(const std::string& baseKey, std::shared_ptr<RedisHub> hub, const std::string& dogname = "");
+
   RedisAdapter(const RedisAdapter& ra) = delete;       //  copy construction not allowed
   RedisAdapter& operator=(const RedisAdapter& ra) = delete;   //  assignment not allowed
 
@@ -169,6 +432,75 @@ public:
   getListsAfter(const std::string& subKey, const RA_ArgsGet& args = {})   //  maxTime ignored
     { return get_forward_stream_list_helper<T>(args.baseKey, subKey, args.minTime, 0, args.count); }
 
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  getValues, getLists, getValuesBefore, getListsBefore, getValuesAfter, getListsAfter
+  //  into a destination
+  //
+  //    dest   : gets the data in place of what it held - its elements, strings and lists are
+  //             assigned rather than rebuilt, so polling a window of the same shape again
+  //             reuses their capacity instead of allocating
+  //    return : true if successful (even if no data), false on failure (dest is then empty)
+  //
+  //  Other arguments as above
+  //
+  template<typename T> bool
+  getValues(const std::string& subKey, TimeValList<T>& dest, const RA_ArgsGet& args = {})  //  count ignored
+    { return get_dest_values<T>(args.baseKey, subKey, args.minTime.id_or_min(), args.maxTime.id_or_max(), 0, false, dest); }
+
+  template<typename T> bool
+  getLists(const std::string& subKey, TimeValList<std::vector<T>>& dest, const RA_ArgsGet& args = {})  //  count ignored
+    { return get_dest_lists<T>(args.baseKey, subKey, args.minTime.id_or_min(), args.maxTime.id_or_max(), 0, false, dest); }
+
+  template<typename T> bool
+  getValuesBefore(const std::string& subKey, TimeValList<T>& dest, const RA_ArgsGet& args = {})  //  minTime ignored
+    { return get_dest_values<T>(args.baseKey, subKey, "-", args.maxTime.id_or_max(), args.count, true, dest); }
+
+  template<typename T> bool
+  getListsBefore(const std::string& subKey, TimeValList<std::vector<T>>& dest, const RA_ArgsGet& args = {})  //  minTime ignored
+    { return get_dest_lists<T>(args.baseKey, subKey, "-", args.maxTime.id_or_max(), args.count, true, dest); }
+
+  template<typename T> bool
+  getValuesAfter(const std::string& subKey, TimeValList<T>& dest, const RA_ArgsGet& args = {})   //  maxTime ignored
+    { return get_dest_values<T>(args.baseKey, subKey, args.minTime.id_or_min(), "+", args.count, false, dest); }
+
+  template<typename T> bool
+  getListsAfter(const std::string& subKey, TimeValList<std::vector<T>>& dest, const RA_ArgsGet& args = {})   //  maxTime ignored
+    { return get_dest_lists<T>(args.baseKey, subKey, args.minTime.id_or_min(), "+", args.count, false, dest); }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  getValues, getLists, getValuesBefore, getListsBefore, getValuesAfter, getListsAfter
+  //  with a memory_resource (T is trivial)
+  //
+  //    mr     : where the result and its lists allocate from, e.g. a monotonic arena
+  //             that is released once the result is done with
+  //    return : PmrTimeValList of TimeVal<T> or of TimeVal<std::pmr::vector<T>>
+  //
+  //  Other arguments as above
+  //
+  template<typename T> PmrTimeValList<T>
+  getValues(const std::string& subKey, std::pmr::memory_resource& mr, const RA_ArgsGet& args = {})  //  count ignored
+    { return get_pmr_values<T>(args.baseKey, subKey, args.minTime.id_or_min(), args.maxTime.id_or_max(), 0, false, mr); }
+
+  template<typename T> PmrTimeValList<std::pmr::vector<T>>
+  getLists(const std::string& subKey, std::pmr::memory_resource& mr, const RA_ArgsGet& args = {})  //  count ignored
+    { return get_pmr_lists<T>(args.baseKey, subKey, args.minTime.id_or_min(), args.maxTime.id_or_max(), 0, false, mr); }
+
+  template<typename T> PmrTimeValList<T>
+  getValuesBefore(const std::string& subKey, std::pmr::memory_resource& mr, const RA_ArgsGet& args = {})  //  minTime ignored
+    { return get_pmr_values<T>(args.baseKey, subKey, "-", args.maxTime.id_or_max(), args.count, true, mr); }
+
+  template<typename T> PmrTimeValList<std::pmr::vector<T>>
+  getListsBefore(const std::string& subKey, std::pmr::memory_resource& mr, const RA_ArgsGet& args = {})  //  minTime ignored
+    { return get_pmr_lists<T>(args.baseKey, subKey, "-", args.maxTime.id_or_max(), args.count, true, mr); }
+
+  template<typename T> PmrTimeValList<T>
+  getValuesAfter(const std::string& subKey, std::pmr::memory_resource& mr, const RA_ArgsGet& args = {})   //  maxTime ignored
+    { return get_pmr_values<T>(args.baseKey, subKey, args.minTime.id_or_min(), "+", args.count, false, mr); }
+
+  template<typename T> PmrTimeValList<std::pmr::vector<T>>
+  getListsAfter(const std::string& subKey, std::pmr::memory_resource& mr, const RA_ArgsGet& args = {})   //  maxTime ignored
+    { return get_pmr_lists<T>(args.baseKey, subKey, args.minTime.id_or_min(), "+", args.count, false, mr); }
+
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  getSingleValue  : get data as T (T is trivial, string or Attrs) at or before maxTime
   //  getSingleList   : get data as type vector<T> (T is trivial) at or before maxTime
@@ -239,6 +571,83 @@ public:
     { return add_single_stream_list_helper(subKey, args.time, data.data(), data.size(), args.trim,
                                            args.approximateTrim); }
 
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Asynchronous get and add
+  //
+  //  Each *Async method takes the same arguments as its synchronous namesake (less dest
+  //  for getSingle*) and returns an RA_Future for what it would have returned - the
+  //  getSingle* futures hold the time and the data together as a TimeVal
+  //
+  //  Operations are queued to the hub's async thread, which sends everything queued
+  //  for the same cluster node as one pipeline on one connection and runs the pipelines
+  //  for different nodes concurrently (up to RA_Options::fanout at once) - so many
+  //  operations can be in flight at once and a batch of them, e.g. the latest value of
+  //  every device, costs about the round trip of the slowest node
+  //
+  //  A then() function or a resumed coroutine runs on one of those threads, which every
+  //  adapter on the hub shares - a get() of another future there can deadlock the hub
+  //
+  //  With REDIS_ADAPTER_COROUTINES (C++20) the futures can be co_awaited, for example
+  //
+  //    auto [time, list] = co_await redis.getSingleListAsync<float>("position");
+  //
+  template<typename T> RA_Future<TimeValList<T>>
+  getValuesAsync(const std::string& subKey, const RA_ArgsGet& args = {})  //  count ignored
+    { return get_async_values<T>(args.baseKey, subKey, args.minTime.id_or_min(), args.maxTime.id_or_max(), 0, false); }
+
+  template<typename T> RA_Future<TimeValList<std::vector<T>>>
+  getListsAsync(const std::string& subKey, const RA_ArgsGet& args = {})  //  count ignored
+    { return get_async_lists<T>(args.baseKey, subKey, args.minTime.id_or_min(), args.maxTime.id_or_max(), 0, false); }
+
+  template<typename T> RA_Future<TimeValList<T>>
+  getValuesBeforeAsync(const std::string& subKey, const RA_ArgsGet& args = {})  //  minTime ignored
+    { return get_async_values<T>(args.baseKey, subKey, "-", args.maxTime.id_or_max(), args.count, true); }
+
+  template<typename T> RA_Future<TimeValList<std::vector<T>>>
+  getListsBeforeAsync(const std::string& subKey, const RA_ArgsGet& args = {})  //  minTime ignored
+    { return get_async_lists<T>(args.baseKey, subKey, "-", args.maxTime.id_or_max(), args.count, true); }
+
+  template<typename T> RA_Future<TimeValList<T>>
+  getValuesAfterAsync(const std::string& subKey, const RA_ArgsGet& args = {})  //  maxTime ignored
+    { return get_async_values<T>(args.baseKey, subKey, args.minTime.id_or_min(), "+", args.count, false); }
+
+  template<typename T> RA_Future<TimeValList<std::vector<T>>>
+  getListsAfterAsync(const std::string& subKey, const RA_ArgsGet& args = {})  //  maxTime ignored
+    { return get_async_lists<T>(args.baseKey, subKey, args.minTime.id_or_min(), "+", args.count, false); }
+
+  template<typename T> RA_Future<TimeVal<T>>
+  getSingleValueAsync(const std::string& subKey, const RA_ArgsGet& args = {});
+
+  template<typename T> RA_Future<TimeVal<std::vector<T>>>
+  getSingleListAsync(const std::string& subKey, const RA_ArgsGet& args = {});
+
+  template<typename T> RA_Future<RA_Time>
+  addSingleValueAsync(const std::string& subKey, const T& data, const RA_ArgsAdd& args = {})
+  {
+    static_assert( ! std::is_same<T, double>(), "use addSingleDoubleAsync for double or 'f' suffix for float literal");
+    if constexpr (std::is_same<T, Attrs>()) { return add_async_single(build_key(subKey), args, data); }
+    else                                    { return add_async_single(build_key(subKey), args, default_field_attrs(data)); }
+  }
+
+  RA_Future<RA_Time> addSingleDoubleAsync(const std::string& subKey, double data, const RA_ArgsAdd& args = {})
+    { return add_async_single(build_key(subKey), args, default_field_attrs(data)); }
+
+  template<template<typename T, size_t S> class C, typename T, size_t S> RA_Future<RA_Time>
+  addSingleListAsync(const std::string& subKey, const C<T, S>& data, const RA_ArgsAdd& args = {})
+    { return add_async_single(build_key(subKey), args, default_field_attrs(data.data(), data.size())); }
+
+  template<typename T> RA_Future<RA_Time>
+  addSingleListAsync(const std::string& subKey, const std::vector<T>& data, const RA_ArgsAdd& args = {})
+    { return add_async_single(build_key(subKey), args, default_field_attrs(data.data(), data.size())); }
+
+  template<typename T> RA_Future<std::vector<RA_Time>>
+  addValuesAsync(const std::string& subKey, const TimeValList<T>& data, uint32_t trim = 1);
+
+  template<typename T> RA_Future<std::vector<RA_Time>>
+  addListsAsync(const std::string& subKey, const TimeValList<std::vector<T>>& data, uint32_t trim = 1);
+
+  RA_Future<bool> delAsync(const std::string& subKey);
+
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  connected : test if server is connected and responsive
   //
@@ -246,6 +655,32 @@ public:
   //
   bool connected() { return reconnect(_redis.ping()); }
 
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  setConnectionCallback : set (or clear with nullptr) a callback for connection state changes
+  //
+  //    func : called with false when the hub starts reconnecting, and with true once it
+  //           has reconnected and restored the readers and subscriptions (see RedisHub)
+  //
+  void setConnectionCallback(RedisHub::ConnectionFn func) { _hub->set_connection_callback(this, func); }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  blockingStats : lease and wait time metrics for the readers' dedicated connections
+  //
+  //    return : see RedisConnection::BlockingStats
+  //
+  RedisConnection::BlockingStats blockingStats() { return _redis.blockingStats(); }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  adjustedIDs : number of adds whose ID was moved to keep the IDs of a key increasing
+  //
+  //  An add at host time gets an ID 1 ns after the last one this adapter allocated for
+  //  the key when its time is not after it - e.g. two adds in the same nanosecond, or a
+  //  host clock that stepped back - and so does an add given a time at most 1 ms before
+  //  that ID (e.g. duplicate times from the caller); an add given an earlier time keeps
+  //  it and is refused as before
+  //
+  uint64_t adjustedIDs() const { return _ids_adjusted; }
+
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  addWatchdog : add a watchdog to the set of watchdogs
   //
@@ -273,6 +708,46 @@ public:
   //
   std::vector<std::string> getWatchdogs() { return _redis.hkeys(_watchdog_key); }
 
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  startWatchdog : add a watchdog that the hub keeps alive until stopWatchdog
+  //  stopWatchdog  : stop keeping a watchdog alive (it is left to expire)
+  //
+  //    dogname    : the name of the watchdog
+  //    expiration : the number of seconds to expire the watchdog
+  //    period     : milliseconds between refreshes, zero for 90% of expiration
+  //    return     : true if successful, false if not successful
+  //
+  //  The hub refreshes all its watchdogs from one thread, sending those due at the same
+  //  time in one pipeline per node - the dogname option is started with (dogname, 1, 900)
+  //
+  bool startWatchdog(const std::string& dogname, uint32_t expiration = 1, uint32_t period = 0);
+
+  bool stopWatchdog(const std::string& dogname) { return _hub->remove_watchdog(_watchdog_key, dogname); }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  startOutageBuffer : keep the adds to a home stream key that fail for lack of a server,
+  //                      and add them once the hub has reconnected
+  //  stopOutageBuffer  : stop buffering a key (entries in memory are lost, entries in a file
+  //                      are left for the next buffer on that file)
+  //  outageStats       : the counters of a key's buffer (all zero if the key is not buffered)
+  //
+  //    subKey  : sub key to buffer
+  //    options : limits of the buffer and where to keep it
+  //    return  : true if successful, false if not successful
+  //
+  //  While a key is buffered, an addSingleValue, addSingleDouble or addSingleList that
+  //  fails, or is made while the hub is reconnecting or earlier entries are waiting, goes
+  //  to the end of the buffer and returns the time it will be added at - the time is fixed
+  //  when the add is made and an entry whose time is not after the last one buffered is
+  //  dropped, so replay cannot break Stream ID order. Replay runs on the async thread in
+  //  pipelines of options.batch entries, each added with the trim it was made with
+  //
+  bool startOutageBuffer(const std::string& subKey, const RA_BufferOptions& options = {});
+
+  bool stopOutageBuffer(const std::string& subKey);
+
+  RA_BufferStats outageStats(const std::string& subKey);
+
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  copy : copy any RA stream key to a home stream key (dest key must not exist)
   //
@@ -299,7 +774,8 @@ public:
   //    subKey : sub key to delete
   //    return : true if successful, false if unsuccessful
   //
-  bool del(const std::string& subKey) { return reconnect(_redis.del(build_key(subKey)) >= 0); }
+  bool del(const std::string& subKey)
+    { std::string key = build_key(subKey); forget_id(key); return reconnect(_redis.del(key) >= 0); }
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  exists : check if a home stream key exists
@@ -322,8 +798,10 @@ public:
   //    message : the message to send
   //    return  : true on success, false on failure
   //
+  //  on a cluster this uses sharded pub/sub (SPUBLISH), see RedisConnection::spublish
+  //
   bool publish(const std::string& subKey, const std::string& message, const std::string& baseKey = "")
-    { return reconnect(_redis.publish(build_key(subKey, baseKey), message) != -1); }
+    { return reconnect(_redis.spublish(build_key(subKey, baseKey), message) != -1); }
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  subscribe   : subscribe for messages on a single channel
@@ -335,6 +813,10 @@ public:
   //    func    : the function to call when message received on this channel
   //    return  : true on success, false on failure
   //
+  //  on a cluster channels are subscribed with sharded pub/sub (SSUBSCRIBE) on the node
+  //  that owns their slot - Redis has no sharded pattern subscribe, so patterns only
+  //  match messages sent with classic PUBLISH (i.e. not by RedisAdapter::publish)
+  //
   bool subscribe(const std::string& subKey, ListenSubFn func, const std::string& baseKey = "");
 
   bool psubscribe(const std::string& subKey, ListenSubFn func, const std::string& baseKey = "");
@@ -366,15 +848,80 @@ public:
   //    baseKey : the base key to read from
   //    subKey  : the sub key to read from
   //    func    : the function to call when information is read on a key
+  //    tag     : anything identifying the caller, to remove just this reader with removeReader
   //    return  : true on success, false on failure
   //
   template<typename T>
-  bool addValuesReader(const std::string& subKey, ReaderSubFn<T> func, const std::string& baseKey = "")
-    { return add_reader_helper(baseKey, subKey, make_reader_callback(func)); }
+  bool addValuesReader(const std::string& subKey, ReaderSubFn<T> func, const std::string& baseKey = "",
+                       const void* tag = nullptr)
+    { return add_reader_helper(baseKey, subKey, make_reader_callback(func), tag); }
 
   template<typename T>
-  bool addListsReader(const std::string& subKey, ReaderSubFn<std::vector<T>> func, const std::string& baseKey = "")
-    { return add_reader_helper(baseKey, subKey, make_list_reader_callback(func)); }
+  bool addListsReader(const std::string& subKey, ReaderSubFn<std::vector<T>> func, const std::string& baseKey = "",
+                      const void* tag = nullptr)
+    { return add_reader_helper(baseKey, subKey, make_list_reader_callback(func), tag); }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  PmrReaderSubFn     : callback function type for stream readers with an arena
+  //  addValuesReaderPmr : add a stream reader for a data key (trivial type) with an arena
+  //  addListsReaderPmr  : add a stream reader for a data key (vector of trivial type) with an arena
+  //
+  //    baseKey : the base key to read from
+  //    subKey  : the sub key to read from
+  //    func    : the function to call when information is read on a key
+  //    arena   : bytes the reader's arena keeps for its batches
+  //    return  : true on success, false on failure
+  //
+  //  Each batch is decoded into the reader's own monotonic arena, which is released as
+  //  soon as the callback returns - so decoding is bump allocation, there is nothing to
+  //  free, and a batch that fits in the arena's bytes never calls malloc (a bigger one
+  //  gets the rest from the default resource) - the data is only valid during the callback
+  //
+  template<typename T>
+  using PmrReaderSubFn = std::function<void(const std::string& baseKey, const std::string& subKey, const PmrTimeValList<T>& data)>;
+
+  template<typename T>
+  bool addValuesReaderPmr(const std::string& subKey, PmrReaderSubFn<T> func, const std::string& baseKey = "",
+                          size_t arena = 64 * 1024)
+    { return add_reader_helper(baseKey, subKey, make_pmr_reader_callback(func, arena)); }
+
+  template<typename T>
+  bool addListsReaderPmr(const std::string& subKey, PmrReaderSubFn<std::pmr::vector<T>> func, const std::string& baseKey = "",
+                         size_t arena = 64 * 1024)
+    { return add_reader_helper(baseKey, subKey, make_pmr_list_reader_callback(func, arena)); }
+
+#ifdef REDIS_ADAPTER_COROUTINES
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  addValuesReaderAsync : add a stream reader whose data is co_awaited batch by batch
+  //  addListsReaderAsync  : as above for vector<T> data
+  //
+  //    subKey  : sub key to read
+  //    baseKey : base key to read
+  //    return  : the batches, each the TimeValList a reader callback would have got
+  //              (closed right away if the reader failed to start)
+  //
+  //  Destroying the batches drops later data, use removeReader() to stop reading
+  //
+  template<typename T> RA_Batches<TimeValList<T>>
+  addValuesReaderAsync(const std::string& subKey, const std::string& baseKey = "")
+  {
+    RA_Batches<TimeValList<T>> batches;
+    auto push = batches.pusher();
+    if ( ! addValuesReader<T>(subKey, [push](const std::string&, const std::string&, const TimeValList<T>& data)
+                                        { push(data); }, baseKey)) { batches.close(); }
+    return batches;
+  }
+
+  template<typename T> RA_Batches<TimeValList<std::vector<T>>>
+  addListsReaderAsync(const std::string& subKey, const std::string& baseKey = "")
+  {
+    RA_Batches<TimeValList<std::vector<T>>> batches;
+    auto push = batches.pusher();
+    if ( ! addListsReader<T>(subKey, [push](const std::string&, const std::string&, const TimeValList<std::vector<T>>& data)
+                                       { push(data); }, baseKey)) { batches.close(); }
+    return batches;
+  }
+#endif
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  addGenericReader : add a reader for a key that does NOT follow RedisAdapter schema
@@ -386,14 +933,18 @@ public:
   bool addGenericReader(const std::string& key, ReaderSubFn<Attrs> func);
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-  //  removeReader : remove all readers for a stream key
+  //  removeReader : remove all readers for a stream key, or only those added with a tag
   //
   //    baseKey : the base key to remove
   //    subKey  : the sub key to remove
+  //    tag     : the tag the readers to remove were added with, nullptr for all of them
   //    return  : true on success, false on failure
   //
-  bool removeReader(const std::string& subKey, const std::string& baseKey = "")
-    { return remove_reader_helper(baseKey, subKey); }
+  //  Returns once the callbacks already queued for the key have run, so what they use can be
+  //  freed - except when called from a reader callback, which returns at once
+  //
+  bool removeReader(const std::string& subKey, const std::string& baseKey = "", const void* tag = nullptr)
+    { return remove_reader_helper(baseKey, subKey, tag); }
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  removeGenericReader : remove all readers for key that does NOT follow RedisAdapter schema
@@ -405,46 +956,58 @@ public:
 
 private:
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-  //  Containers for stream data suggested by the redis++ readme.md
+  //  Containers for stream data as the redis++ readme.md suggests, but with the flat
+  //  RA_Fields in place of an unordered_map for the fields of an entry
   //    https://github.com/sewenew/redis-plus-plus#redis-stream
   //
-  using Item = std::pair<std::string, Attrs>;
+  using Fields = RA_Fields;
+  using Item = std::pair<std::string, Fields>;
   using ItemStream = std::vector<Item>;
   using Streams = std::unordered_map<std::string, ItemStream>;
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  Redis key and field constants
   //
-  const std::string DEFAULT_FIELD = "_";            //  default field in stream Attrs
-  const std::string STOP_STUB     = "<$-STOP-$>";   //  stream stub to stop reader thread
+  const std::string DEFAULT_FIELD = "_";            //  default field in stream Fields
+  const std::string WAKE_STUB     = "<$-WAKE-$>";   //  channel stub to wake pub/sub listener
 
   std::string build_key(const std::string& subKey, const std::string& baseKey = "") const;
 
-  std::pair<std::string, std::string> split_key(const std::string& key) const;
-
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  Helper functions adding and removing stream readers
   //
-  using reader_sub_fn = std::function<void(const std::string& baseKey, const std::string& subKey, const ItemStream& data)>;
-
-  uint32_t reader_token(const std::string& key);
+  using reader_sub_fn = RedisHub::reader_sub_fn;
 
-  bool add_reader_helper(const std::string& baseKey, const std::string& subKey, reader_sub_fn func);
+  bool add_reader_helper(const std::string& baseKey, const std::string& subKey, reader_sub_fn func,
+                         const void* tag = nullptr);
 
   template<typename T> reader_sub_fn make_reader_callback(ReaderSubFn<T> func) const;
 
   template<typename T> reader_sub_fn make_list_reader_callback(ReaderSubFn<std::vector<T>> func) const;
 
-  bool remove_reader_helper(const std::string& baseKey, const std::string& subKey);
+  template<typename T> reader_sub_fn make_pmr_reader_callback(PmrReaderSubFn<T> func, size_t arena) const;
+
+  template<typename T> reader_sub_fn make_pmr_list_reader_callback(PmrReaderSubFn<std::pmr::vector<T>> func, size_t arena) const;
+
+  //  the arena of a reader with one, only used by the replier thread its key hashes to
+  struct reader_arena
+  {
+    reader_arena(size_t size) : buffer(size), mono(buffer.data(), buffer.size()) {}
+
+    std::vector<std::byte> buffer;
+    std::pmr::monotonic_buffer_resource mono;
+  };
+
+  bool remove_reader_helper(const std::string& baseKey, const std::string& subKey, const void* tag = nullptr);
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-  //  Helper functions for getting and setting DEFAULT_FIELD in Attrs
+  //  Helper functions for getting and setting DEFAULT_FIELD in Fields
   //
-  template<typename T> auto default_field_value(const Attrs& attrs) const;
+  template<typename T> auto default_field_value(const Fields& fields) const;
 
-  template<typename T> Attrs default_field_attrs(const T* data, size_t size) const;
+  template<typename T> Fields default_field_attrs(const T* data, size_t size) const;
 
-  template<typename T> Attrs default_field_attrs(const T& data) const;
+  template<typename T> Fields default_field_attrs(const T& data) const;
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  Helper functions for getting and adding data
@@ -471,53 +1034,182 @@ private:
   add_single_stream_list_helper(const std::string& subKey, RA_Time time, const T* data, size_t size,
                                 uint32_t trim, bool approximateTrim);
 
+  RA_Time add_single(const std::string& key, const RA_ArgsAdd& args, const Fields& attrs);
+
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-  //  Redis server
+  //  Stream ID allocation - the last ID allocated for each key written by this adapter
   //
-  RA_Options _options;
-  RedisConnection _redis;
+  //  ID_TOLERANCE  : most nanoseconds a given time may be before the last ID and still be moved after it
+  //  MAX_LAST_IDS  : most keys remembered, past it the keys not written in the last second are forgotten
+  //
+  static constexpr int64_t ID_TOLERANCE = 1000000;
+  static constexpr size_t MAX_LAST_IDS = 65536;
+
+  std::string next_id(const std::string& key, RA_Time time);
+  void forget_id(const std::string& key);
+
+  std::mutex _ids_mtx;
+  std::unordered_map<std::string, int64_t> _last_ids;
+  std::atomic<uint64_t> _ids_adjusted{0};
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Helper functions for converting stream items to TimeValList (or PmrTimeValList)
+  //
+  template<typename T, typename L = TimeValList<T>, typename It>
+  L item_values(It beg, It end, L ret = {}) const;
+
+  template<typename T, typename L = TimeValList<std::vector<T>>, typename It>
+  L item_lists(It beg, It end, L ret = {}) const;
+
+  template<typename T, typename It> void assign_values(It beg, It end, TimeValList<T>& dest) const;
+
+  template<typename T, typename It> void assign_lists(It beg, It end, TimeValList<std::vector<T>>& dest) const;
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Helper functions for getting data into a destination or with a memory_resource
+  //
+  bool get_range(const std::string& key, const std::string& minID, const std::string& maxID,
+                 uint32_t count, bool reverse, ItemStream& raw);
+
+  template<typename T> bool
+  get_dest_values(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                  const std::string& maxID, uint32_t count, bool reverse, TimeValList<T>& dest);
+
+  template<typename T> bool
+  get_dest_lists(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                 const std::string& maxID, uint32_t count, bool reverse, TimeValList<std::vector<T>>& dest);
+
+  template<typename T> PmrTimeValList<T>
+  get_pmr_values(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                 const std::string& maxID, uint32_t count, bool reverse, std::pmr::memory_resource& mr);
+
+  template<typename T> PmrTimeValList<std::pmr::vector<T>>
+  get_pmr_lists(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                const std::string& maxID, uint32_t count, bool reverse, std::pmr::memory_resource& mr);
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Asynchronous operations
+  //
+  //  The ops run on the hub (see RedisHub::async_op) - the adapter counts the ones it has
+  //  queued until they are done, since their conversions call back into the adapter
+  //
+  using async_op = RedisHub::async_op;
+
+  void async_queue(async_op op);
+
+  template<typename R> RA_Future<R>
+  get_async_range(const std::string& key, const std::string& beg, const std::string& end, uint32_t count,
+                  bool reverse, std::function<R(bool ok, ItemStream& raw)> conv);
+
+  template<typename T> RA_Future<TimeValList<T>>
+  get_async_values(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                   const std::string& maxID, uint32_t count, bool reverse);
+
+  template<typename T> RA_Future<TimeValList<std::vector<T>>>
+  get_async_lists(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                  const std::string& maxID, uint32_t count, bool reverse);
+
+  RA_Future<RA_Time> add_async_single(const std::string& key, const RA_ArgsAdd& args, Fields attrs);
+
+  RA_Future<std::vector<RA_Time>> add_async_multi(const std::string& key, std::vector<Item> items, uint32_t trim);
+
+  std::mutex _async_mtx;
+  std::condition_variable _async_cv;
+  size_t _async_pending = 0;
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Redis server - the hub's connection, shared with every adapter attached to the hub
+  //
+  friend class RedisHub;
+
+  std::shared_ptr<RedisHub> _hub;
+  RedisConnection& _redis;
   std::string _base_key;
 
-  int32_t reconnect(int32_t result);
-  std::atomic_bool _connecting;
-  std::thread _reconnect_thd;
-  std::atomic<bool> _shutdown{false};
+  int32_t reconnect(int32_t result) { return _hub->reconnect(result); }
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  Watchdog
   //
   std::string _watchdog_key;
-  std::thread _watchdog_thd;
-  std::condition_variable _watchdog_cv;
-  std::atomic<bool> _watchdog_run;
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-  //  Stream readers
+  //  Outage buffers
   //
-  bool start_reader(uint32_t token);
-  bool stop_reader(uint32_t token);
+  //  An entry stays in its buffer until the replay pipeline that carried it is done, so
+  //  adds made during a replay queue up behind it rather than overtake it
+  //
+  struct outage_buffer
+  {
+    std::unique_ptr<RA_Buffer> ring;
+    uint32_t batch;
+    uint64_t gen;               //  tells a replay its buffer was stopped (and maybe restarted)
+    bool replaying = false;
+    RA_BufferStats stats;
+  };
 
-  std::atomic<bool> _readers_defer;
+  RA_Time outage_add(const std::string& key, const std::string& id, const RA_ArgsAdd& args,
+                     const Fields& attrs, bool failed);
 
-  std::mutex _reader_mtx;
+  void outage_replay();
 
-  struct reader_info
+  void outage_batch(const std::string& key, outage_buffer& buf);
+
+  std::mutex _outage_mtx;
+  std::unordered_map<std::string, outage_buffer> _outage;   //  key -> buffer
+  std::atomic<size_t> _outage_keys{0};                      //  so unbuffered adds skip the lock
+  std::atomic<bool> _outage_run{true};
+  uint64_t _outage_gen = 0;
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Stream readers - run by the hub, the adapter only remembers if it is deferring them
+  //
+  std::atomic<bool> _readers_defer{false};
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Pub/sub listener
+  //
+  //  Subscriptions are grouped into shards, each with one subscriber connection owned by
+  //  a thread that runs its consume loop - on a cluster every channel is served by the
+  //  shard for the node that owns its slot (sharded pub/sub), while patterns (and every
+  //  channel on a single server) are served by the classic shard, keyed by empty string
+  //
+  //  The Subscriber is not thread safe, so subscribe() etc. only update the dispatch
+  //  tables and queue a change in the shard's todo, then publish to the shard's wake
+  //  channel so the listener drops out of consume() and applies the change itself
+  //
+  enum class listen_op { sub, psub, unsub, punsub };
+
+  struct listen_shard
   {
     std::thread thread;
-    std::unordered_map<std::string, std::vector<reader_sub_fn>> subs;
-    std::unordered_map<std::string, std::string> keyids;
-    std::string stop;
-    std::atomic<bool> run = false;
-
-    //  used by start_reader() to confirm the reader thread has begun its read loop -
-    //  these live here (in the _reader map) rather than as locals in start_reader()
-    //  so their lifetime safely covers the reader thread's lifetime, not just one call
-    std::mutex start_mx;
-    std::condition_variable start_cv;
+    std::string wake;       //  channel served by this shard, published to unblock consume()
+    bool live = false;      //  the thread has a subscriber, so changes can be queued in todo
+    bool renew = true;      //  (re)build the subscriber from the dispatch tables
+    std::vector<std::pair<listen_op, std::string>> todo;
   };
-  std::unordered_map<uint32_t, reader_info> _reader;
 
-  ThreadPool _replier_pool;
+  bool listen_helper(listen_op op, const std::string& chan, ListenSubFn func);
+
+  bool listen_queue(listen_op op, const std::string& chan, const std::string& node);
+
+  void listen_regroup();
+
+  void listen_poke(const std::string& node, const std::string& wake);
+
+  void listen_loop(std::string node);
+
+  void listen_dispatch(const std::string& chan, const std::vector<ListenSubFn>& funcs, const std::string& msg);
+
+  std::mutex _listen_mtx;
+  std::condition_variable _listen_cv;
+  std::atomic<bool> _listen_run{true};
+  std::string _listen_wake;
+
+  std::unordered_map<std::string, listen_shard> _listen_shards;           //  node -> shard
+  std::unordered_map<std::string, std::string> _listen_where;             //  channel -> node
+  std::unordered_map<std::string, std::vector<ListenSubFn>> _listen_chans;  //  channel -> callbacks
+  std::unordered_map<std::string, std::vector<ListenSubFn>> _listen_pats;   //  pattern -> callbacks
 };
 
 #include "RedisAdapterTempl.hpp"
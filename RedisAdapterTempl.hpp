@@ -8,40 +8,42 @@
 #include "RedisAdapter.hpp"
 
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-//  Helper functions for getting DEFAULT_FIELD in Attrs
+//  Helper functions for getting DEFAULT_FIELD in Fields
 //
-template<typename T> auto RedisAdapter::default_field_value(const Attrs& attrs) const
+template<typename T> auto RedisAdapter::default_field_value(const Fields& fields) const
 {
   static_assert(std::is_trivial<T>(), "wrong type T");
 
   swr::Optional<T> ret;
-  if (attrs.count(DEFAULT_FIELD)) ret = *(const T*)attrs.at(DEFAULT_FIELD).data();
+  auto it = fields.find(DEFAULT_FIELD);
+  if (it != fields.end()) ret = *(const T*)it->second.data();
   return ret;
 }
 //  string specialization
-template<> inline auto RedisAdapter::default_field_value<std::string>(const Attrs& attrs) const
+template<> inline auto RedisAdapter::default_field_value<std::string>(const Fields& fields) const
 {
   std::string ret;
-  if (attrs.count(DEFAULT_FIELD)) ret = attrs.at(DEFAULT_FIELD);
+  auto it = fields.find(DEFAULT_FIELD);
+  if (it != fields.end()) ret = it->second;
   return ret;
 }
 
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-//  Helper functions for setting DEFAULT_FIELD in Attrs
+//  Helper functions for setting DEFAULT_FIELD in Fields
 //
-template<typename T> RedisAdapter::Attrs RedisAdapter::default_field_attrs(const T& data) const
+template<typename T> RedisAdapter::Fields RedisAdapter::default_field_attrs(const T& data) const
 {
   static_assert(std::is_trivial<T>(), "wrong type T");
 
   return {{ DEFAULT_FIELD, std::string((const char*)&data, sizeof(T)) }};
 }
 //  string specialization
-template<> inline RedisAdapter::Attrs RedisAdapter::default_field_attrs(const std::string& data) const
+template<> inline RedisAdapter::Fields RedisAdapter::default_field_attrs(const std::string& data) const
 {
   return {{ DEFAULT_FIELD, data }};
 }
 //  overload for buffer as ptr, size
-template<typename T> RedisAdapter::Attrs RedisAdapter::default_field_attrs(const T* data, size_t size) const
+template<typename T> RedisAdapter::Fields RedisAdapter::default_field_attrs(const T* data, size_t size) const
 {
   static_assert(std::is_trivial<T>(), "wrong type T");
 
@@ -105,7 +107,7 @@ RedisAdapter::get_forward_stream_helper(const std::string& baseKey, const std::s
   for (const auto& rawItem : raw)
   {
     retItem.first = RA_Time(rawItem.first);
-    retItem.second = rawItem.second;
+    retItem.second = Attrs(rawItem.second);
     ret.push_back(retItem);
   }
   return ret;
@@ -205,7 +207,7 @@ RedisAdapter::get_reverse_stream_helper(const std::string& baseKey, const std::s
   for (auto rawItem = raw.rbegin(); rawItem != raw.rend(); rawItem++)   //  reverse iterate
   {
     retItem.first = RA_Time(rawItem->first);
-    retItem.second = rawItem->second;
+    retItem.second = Attrs(rawItem->second);
     ret.push_back(retItem);
   }
   return ret;
@@ -294,7 +296,7 @@ RedisAdapter::get_single_stream_helper(const std::string& baseKey, const std::st
 
   if (raw.size())
   {
-    dest = raw.front().second;
+    dest = Attrs(raw.front().second);
     return RA_Time(raw.front().first);
   }
   return {};
@@ -350,9 +352,9 @@ RedisAdapter::addValues(const std::string& subKey, const TimeValList<T>& data, u
   std::string key = build_key(subKey);
   for (const auto& item : data)
   {
-    Attrs attrs = default_field_attrs(item.second);
+    Fields attrs = default_field_attrs(item.second);
 
-    std::string id = _redis.xadd(key, item.first.id_or_now(), attrs.begin(), attrs.end());
+    std::string id = _redis.xadd(key, next_id(key, item.first), attrs.begin(), attrs.end());
 
     if (id.size()) { ret.push_back(RA_Time(id)); }
   }
@@ -369,7 +371,7 @@ RedisAdapter::addValues(const std::string& subKey, const TimeValList<Attrs>& dat
   std::string key = build_key(subKey);
   for (const auto& item : data)
   {
-    std::string id = _redis.xadd(key, item.first.id_or_now(), item.second.begin(), item.second.end());
+    std::string id = _redis.xadd(key, next_id(key, item.first), item.second.begin(), item.second.end());
 
     if (id.size()) { ret.push_back(RA_Time(id)); }
   }
@@ -396,9 +398,9 @@ RedisAdapter::addLists(const std::string& subKey, const TimeValList<std::vector<
   std::string key = build_key(subKey);
   for (const auto& item : data)
   {
-    Attrs attrs = default_field_attrs(item.second.data(), item.second.size());
+    Fields attrs = default_field_attrs(item.second.data(), item.second.size());
 
-    std::string id = _redis.xadd(key, item.first.id_or_now(), attrs.begin(), attrs.end());
+    std::string id = _redis.xadd(key, next_id(key, item.first), attrs.begin(), attrs.end());
 
     if (id.size()) { ret.push_back(RA_Time(id)); }
   }
@@ -423,30 +425,13 @@ RedisAdapter::addSingleValue(const std::string& subKey, const T& data, const RA_
   static_assert( ! std::is_same<T, double>(), "use addSingleDouble for double or 'f' suffix for float literal");
   static_assert(std::is_trivial<T>() || std::is_same<T, std::string>(), "wrong type T");
 
-  std::string key = build_key(subKey);
-  Attrs attrs = default_field_attrs(data);
-
-  std::string id = args.trim ? _redis.xaddTrim(key, args.time.id_or_now(), attrs.begin(), attrs.end(),
-                                              args.trim, args.approximateTrim)
-                             : _redis.xadd(key, args.time.id_or_now(), attrs.begin(), attrs.end());
-
-  if ( ! reconnect(id.size())) { return RA_NOT_CONNECTED; }
-
-  return RA_Time(id);
+  return add_single(build_key(subKey), args, default_field_attrs(data));
 }
 //  Attrs specialization
 template<> inline RA_Time
 RedisAdapter::addSingleValue(const std::string& subKey, const Attrs& data, const RA_ArgsAdd& args)
 {
-  std::string key = build_key(subKey);
-
-  std::string id = args.trim ? _redis.xaddTrim(key, args.time.id_or_now(), data.begin(), data.end(),
-                                              args.trim, args.approximateTrim)
-                             : _redis.xadd(key, args.time.id_or_now(), data.begin(), data.end());
-
-  if ( ! reconnect(id.size())) { return RA_NOT_CONNECTED; }
-
-  return RA_Time(id);
+  return add_single(build_key(subKey), args, data);
 }
 
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -465,16 +450,7 @@ RedisAdapter::add_single_stream_list_helper(const std::string& subKey, RA_Time t
 {
   static_assert(std::is_trivial<T>(), "wrong type T");
 
-  std::string key = build_key(subKey);
-  Attrs attrs = default_field_attrs(data, size);
-
-  std::string id = trim ? _redis.xaddTrim(key, time.id_or_now(), attrs.begin(), attrs.end(), trim,
-                                         approximateTrim)
-                        : _redis.xadd(key, time.id_or_now(), attrs.begin(), attrs.end());
-
-  if ( ! reconnect(id.size())) { return RA_NOT_CONNECTED; }
-
-  return RA_Time(id);
+  return add_single(build_key(subKey), { time, trim, approximateTrim }, default_field_attrs(data, size));
 }
 
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -483,7 +459,7 @@ RedisAdapter::add_single_stream_list_helper(const std::string& subKey, RA_Time t
 //    func   : user callback that wants data as type T
 //    base   : base key of desired data
 //    sub    : sub key of desired data
-//    raw    : raw data as type Attrs
+//    raw    : raw data as type Fields
 //    return : closure that reader thread can call upon data arrival
 //
 template<typename T> RedisAdapter::reader_sub_fn
@@ -519,7 +495,7 @@ RedisAdapter::make_reader_callback(ReaderSubFn<Attrs> func) const
     for (const auto& rawItem : raw)
     {
       retItem.first = RA_Time(rawItem.first);
-      retItem.second = rawItem.second;
+      retItem.second = Attrs(rawItem.second);
       ret.push_back(retItem);
     }
     func(base, sub, ret);
@@ -532,7 +508,7 @@ RedisAdapter::make_reader_callback(ReaderSubFn<Attrs> func) const
 //    func   : user callback that wants data as vector of T
 //    base   : base key of desired data
 //    sub    : sub key of desired data
-//    raw    : raw data as type Attrs
+//    raw    : raw data as type Fields
 //    return : closure that reader thread can call upon data arrival
 //
 template<typename T> RedisAdapter::reader_sub_fn
@@ -557,3 +533,359 @@ RedisAdapter::make_list_reader_callback(ReaderSubFn<std::vector<T>> func) const
     func(base, sub, ret);
   };
 }
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  make_pmr_reader_callback      : wrap user callback to convert data to T in an arena
+//  make_pmr_list_reader_callback : wrap user callback to convert data to pmr vector of T in an arena
+//
+//    func   : user callback that wants the data
+//    arena  : bytes of the arena the data is converted into
+//    return : closure that reader thread can call upon data arrival
+//
+//  The arena is released after every callback, once the data it holds is destroyed
+//
+template<typename T> RedisAdapter::reader_sub_fn
+RedisAdapter::make_pmr_reader_callback(PmrReaderSubFn<T> func, size_t arena) const
+{
+  static_assert(std::is_trivial<T>(), "wrong type T");
+
+  auto mem = std::make_shared<reader_arena>(arena);
+  return [&, func, mem](const std::string& base, const std::string& sub, const ItemStream& raw)
+  {
+    {
+      PmrTimeValList<T> ret = item_values<T>(raw.begin(), raw.end(), PmrTimeValList<T>(&mem->mono));
+      func(base, sub, ret);
+    }
+    mem->mono.release();
+  };
+}
+
+template<typename T> RedisAdapter::reader_sub_fn
+RedisAdapter::make_pmr_list_reader_callback(PmrReaderSubFn<std::pmr::vector<T>> func, size_t arena) const
+{
+  static_assert(std::is_trivial<T>(), "wrong type T");
+
+  auto mem = std::make_shared<reader_arena>(arena);
+  return [&, func, mem](const std::string& base, const std::string& sub, const ItemStream& raw)
+  {
+    {
+      using L = PmrTimeValList<std::pmr::vector<T>>;
+      L ret = item_lists<T>(raw.begin(), raw.end(), L(&mem->mono));
+      func(base, sub, ret);
+    }
+    mem->mono.release();
+  };
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  get_dest_values : get data as type T (T is trivial, string or Attrs) into a destination
+//  get_dest_lists  : get data as type vector<T> (T is trivial) into a destination
+//
+//    baseKey : base key of device
+//    subKey  : sub key to get data from
+//    minID   : lowest id ("-" for the start of the stream)
+//    maxID   : highest id ("+" for the end of the stream)
+//    count   : max number of items to get (zero for all)
+//    reverse : true to get the newest count items
+//    dest    : gets the data in time order, reusing what it held
+//    return  : true if successful, false on failure
+//
+template<typename T> bool
+RedisAdapter::get_dest_values(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                              const std::string& maxID, uint32_t count, bool reverse, TimeValList<T>& dest)
+{
+  ItemStream raw;
+  bool ok = get_range(build_key(subKey, baseKey), minID, maxID, count, reverse, raw);
+
+  if (reverse) { assign_values<T>(raw.rbegin(), raw.rend(), dest); }
+  else         { assign_values<T>(raw.begin(), raw.end(), dest); }
+  return ok;
+}
+
+template<typename T> bool
+RedisAdapter::get_dest_lists(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                             const std::string& maxID, uint32_t count, bool reverse, TimeValList<std::vector<T>>& dest)
+{
+  ItemStream raw;
+  bool ok = get_range(build_key(subKey, baseKey), minID, maxID, count, reverse, raw);
+
+  if (reverse) { assign_lists<T>(raw.rbegin(), raw.rend(), dest); }
+  else         { assign_lists<T>(raw.begin(), raw.end(), dest); }
+  return ok;
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  get_pmr_values : get data as type T (T is trivial) allocated from a memory_resource
+//  get_pmr_lists  : get data as type pmr vector<T> (T is trivial) allocated from a memory_resource
+//
+//    baseKey : base key of device
+//    subKey  : sub key to get data from
+//    minID   : lowest id ("-" for the start of the stream)
+//    maxID   : highest id ("+" for the end of the stream)
+//    count   : max number of items to get (zero for all)
+//    reverse : true to get the newest count items
+//    mr      : where the result allocates from
+//    return  : PmrTimeValList in time order
+//
+template<typename T> RedisAdapter::PmrTimeValList<T>
+RedisAdapter::get_pmr_values(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                             const std::string& maxID, uint32_t count, bool reverse, std::pmr::memory_resource& mr)
+{
+  static_assert(std::is_trivial<T>(), "wrong type T");
+
+  ItemStream raw;
+  get_range(build_key(subKey, baseKey), minID, maxID, count, reverse, raw);
+
+  if (reverse) return item_values<T>(raw.rbegin(), raw.rend(), PmrTimeValList<T>(&mr));
+  return item_values<T>(raw.begin(), raw.end(), PmrTimeValList<T>(&mr));
+}
+
+template<typename T> RedisAdapter::PmrTimeValList<std::pmr::vector<T>>
+RedisAdapter::get_pmr_lists(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                            const std::string& maxID, uint32_t count, bool reverse, std::pmr::memory_resource& mr)
+{
+  using L = PmrTimeValList<std::pmr::vector<T>>;
+  ItemStream raw;
+  get_range(build_key(subKey, baseKey), minID, maxID, count, reverse, raw);
+
+  if (reverse) return item_lists<T>(raw.rbegin(), raw.rend(), L(&mr));
+  return item_lists<T>(raw.begin(), raw.end(), L(&mr));
+}
+
+//  item_values : convert stream items to TimeValList<T> (T is trivial, string or Attrs)
+//  item_lists  : convert stream items to TimeValList<vector<T>> (T is trivial)
+//
+//    beg    : first item to convert (reverse iterators give reverse order)
+//    end    : one past the last item to convert
+//    return : the items that hold data of the right shape
+//
+template<typename T, typename L, typename It> L
+RedisAdapter::item_values(It beg, It end, L ret) const
+{
+  static_assert(std::is_trivial<T>() || std::is_same<T, std::string>() || std::is_same<T, Attrs>(), "wrong type T");
+
+  ret.reserve(ret.size() + std::distance(beg, end));
+  for (auto rawItem = beg; rawItem != end; rawItem++)
+  {
+    if constexpr (std::is_same<T, Attrs>()) { ret.emplace_back(RA_Time(rawItem->first), Attrs(rawItem->second)); }
+    else
+    {
+      auto maybe = default_field_value<T>(rawItem->second);
+      if constexpr (std::is_same<T, std::string>())
+        { if (rawItem->second.count(DEFAULT_FIELD)) ret.emplace_back(RA_Time(rawItem->first), maybe); }
+      else
+        { if (maybe) ret.emplace_back(RA_Time(rawItem->first), maybe.value()); }
+    }
+  }
+  return ret;
+}
+
+//  the list is assigned in place, so a pmr list gets its memory from the result's resource
+template<typename T, typename L, typename It> L
+RedisAdapter::item_lists(It beg, It end, L ret) const
+{
+  static_assert(std::is_trivial<T>(), "wrong type T");
+
+  ret.reserve(ret.size() + std::distance(beg, end));
+  for (auto rawItem = beg; rawItem != end; rawItem++)
+  {
+    auto field = rawItem->second.find(DEFAULT_FIELD);
+    if (field == rawItem->second.end() || field->second.empty()) continue;
+
+    const std::string& str = field->second;
+    auto& item = ret.emplace_back();
+    item.first = RA_Time(rawItem->first);
+    item.second.assign((const T*)str.data(), (const T*)(str.data() + str.size()));
+  }
+  return ret;
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  assign_values : convert stream items into a TimeValList<T> (T is trivial, string or Attrs)
+//  assign_lists  : convert stream items into a TimeValList<vector<T>> (T is trivial)
+//
+//    beg    : first item to convert (reverse iterators give reverse order)
+//    end    : one past the last item to convert
+//    dest   : gets the items that hold data of the right shape - its elements are assigned
+//             in place, so their strings and lists keep their capacity (and Attrs keep the
+//             nodes of the fields they still have), and any left over are removed
+//
+template<typename T, typename It> void
+RedisAdapter::assign_values(It beg, It end, TimeValList<T>& dest) const
+{
+  static_assert(std::is_trivial<T>() || std::is_same<T, std::string>() || std::is_same<T, Attrs>(), "wrong type T");
+
+  size_t num = 0;
+  for (auto rawItem = beg; rawItem != end; rawItem++)
+  {
+    auto field = rawItem->second.find(DEFAULT_FIELD);
+    if constexpr ( ! std::is_same<T, Attrs>()) { if (field == rawItem->second.end()) continue; }
+
+    if (num == dest.size()) { dest.emplace_back(); }
+    TimeVal<T>& item = dest[num++];
+    item.first = RA_Time(rawItem->first);
+
+    if constexpr (std::is_same<T, Attrs>())
+    {
+      //  drop the fields the entry does not have and assign the rest over the old values
+      Attrs& attrs = item.second;
+      for (auto it = attrs.begin(); it != attrs.end(); )
+        { it = rawItem->second.count(it->first) ? std::next(it) : attrs.erase(it); }
+      for (const auto& pair : rawItem->second)
+      {
+        if (&*rawItem->second.find(pair.first) != &pair) continue;   //  the first of a repeated field wins
+        attrs[pair.first].assign(pair.second);
+      }
+    }
+    else if constexpr (std::is_same<T, std::string>()) { item.second.assign(field->second); }
+    else                                               { item.second = *(const T*)field->second.data(); }
+  }
+  dest.resize(num);
+}
+
+template<typename T, typename It> void
+RedisAdapter::assign_lists(It beg, It end, TimeValList<std::vector<T>>& dest) const
+{
+  static_assert(std::is_trivial<T>(), "wrong type T");
+
+  size_t num = 0;
+  for (auto rawItem = beg; rawItem != end; rawItem++)
+  {
+    auto field = rawItem->second.find(DEFAULT_FIELD);
+    if (field == rawItem->second.end() || field->second.empty()) continue;
+
+    const std::string& str = field->second;
+    if (num == dest.size()) { dest.emplace_back(); }
+    TimeVal<std::vector<T>>& item = dest[num++];
+    item.first = RA_Time(rawItem->first);
+    item.second.assign((const T*)str.data(), (const T*)(str.data() + str.size()));
+  }
+  dest.resize(num);
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  get_async_range : queue an XRANGE (or XREVRANGE) and convert its reply when it arrives
+//
+//    key     : the stream key
+//    beg     : lowest id ("-" for the start of the stream)
+//    end     : highest id ("+" for the end of the stream)
+//    count   : max number of items to get (zero for all)
+//    reverse : true to get the newest count items (XREVRANGE)
+//    conv    : converts the raw items (in stream order) to the result, ok false on failure
+//    return  : future for the converted result
+//
+template<typename R> RA_Future<R>
+RedisAdapter::get_async_range(const std::string& key, const std::string& beg, const std::string& end,
+                              uint32_t count, bool reverse, std::function<R(bool ok, ItemStream& raw)> conv)
+{
+  RA_Promise<R> promise;
+  async_queue({ key, 1,
+    [=](swr::Pipeline& pipe)
+    {
+      if (reverse) { count ? pipe.xrevrange(key, end, beg, count) : pipe.xrevrange(key, end, beg); }
+      else         { count ? pipe.xrange(key, beg, end, count) : pipe.xrange(key, beg, end); }
+    },
+    [=](swr::QueuedReplies* replies, size_t idx)
+    {
+      ItemStream raw;
+      bool ok = false;
+      if (replies)
+      {
+        try
+        {
+          replies->get(idx, std::back_inserter(raw));
+          if (reverse) std::reverse(raw.begin(), raw.end());
+          ok = true;
+        }
+        catch (const swr::Error& e) { syslog(LOG_ERR, "RedisAdapter::%s %s", __func__, e.what()); }
+      }
+      promise.set(conv(ok, raw));
+    },
+    true
+  });
+  return promise.future();
+}
+
+template<typename T> RA_Future<RedisAdapter::TimeValList<T>>
+RedisAdapter::get_async_values(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                               const std::string& maxID, uint32_t count, bool reverse)
+{
+  return get_async_range<TimeValList<T>>(build_key(subKey, baseKey), minID, maxID, count, reverse,
+    [this](bool, ItemStream& raw) { return item_values<T>(raw.begin(), raw.end()); });
+}
+
+template<typename T> RA_Future<RedisAdapter::TimeValList<std::vector<T>>>
+RedisAdapter::get_async_lists(const std::string& baseKey, const std::string& subKey, const std::string& minID,
+                              const std::string& maxID, uint32_t count, bool reverse)
+{
+  return get_async_range<TimeValList<std::vector<T>>>(build_key(subKey, baseKey), minID, maxID, count, reverse,
+    [this](bool, ItemStream& raw) { return item_lists<T>(raw.begin(), raw.end()); });
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  getSingleValueAsync : get data as T (T is trivial, string or Attrs) at or before maxTime
+//  getSingleListAsync  : get data as type vector<T> (T is trivial) at or before maxTime
+//
+//    subKey : sub key to get data from
+//    args   : baseKey and maxTime are used
+//    return : future for the time and data - the time is zero if there is no such data
+//             and RA_NOT_CONNECTED on failure
+//
+template<typename T> RA_Future<RedisAdapter::TimeVal<T>>
+RedisAdapter::getSingleValueAsync(const std::string& subKey, const RA_ArgsGet& args)
+{
+  return get_async_range<TimeVal<T>>(build_key(subKey, args.baseKey), "-", args.maxTime.id_or_max(), 1, true,
+    [this](bool ok, ItemStream& raw)
+    {
+      if ( ! ok) return TimeVal<T>(RA_NOT_CONNECTED, T());
+      auto vals = item_values<T>(raw.begin(), raw.end());
+      return vals.size() ? std::move(vals.front()) : TimeVal<T>();
+    });
+}
+
+template<typename T> RA_Future<RedisAdapter::TimeVal<std::vector<T>>>
+RedisAdapter::getSingleListAsync(const std::string& subKey, const RA_ArgsGet& args)
+{
+  return get_async_range<TimeVal<std::vector<T>>>(build_key(subKey, args.baseKey), "-", args.maxTime.id_or_max(), 1, true,
+    [this](bool ok, ItemStream& raw)
+    {
+      if ( ! ok) return TimeVal<std::vector<T>>(RA_NOT_CONNECTED, {});
+      auto vals = item_lists<T>(raw.begin(), raw.end());
+      return vals.size() ? std::move(vals.front()) : TimeVal<std::vector<T>>();
+    });
+}
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  addValuesAsync : add multiple data items of type T (T is trivial, string or Attrs)
+//  addListsAsync  : add multiple vector<T> as data items (T is trivial)
+//
+//    subKey : sub key to add data to
+//    data   : times and data to add (0 time means host time)
+//    trim   : trim to greater of this value or number of data items
+//    return : future for the times of successfully added data items
+//
+template<typename T> RA_Future<std::vector<RA_Time>>
+RedisAdapter::addValuesAsync(const std::string& subKey, const TimeValList<T>& data, uint32_t trim)
+{
+  std::string key = build_key(subKey);
+  std::vector<Item> items;
+  items.reserve(data.size());
+  for (const auto& item : data)
+  {
+    if constexpr (std::is_same<T, Attrs>()) { items.emplace_back(next_id(key, item.first), item.second); }
+    else                                    { items.emplace_back(next_id(key, item.first), default_field_attrs(item.second)); }
+  }
+  return add_async_multi(key, std::move(items), trim);
+}
+
+template<typename T> RA_Future<std::vector<RA_Time>>
+RedisAdapter::addListsAsync(const std::string& subKey, const TimeValList<std::vector<T>>& data, uint32_t trim)
+{
+  std::string key = build_key(subKey);
+  std::vector<Item> items;
+  items.reserve(data.size());
+  for (const auto& item : data)
+    { items.emplace_back(next_id(key, item.first), default_field_attrs(item.second.data(), item.second.size())); }
+
+  return add_async_multi(key, std::move(items), trim);
+}
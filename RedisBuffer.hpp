@@ -0,0 +1,265 @@
+//
+//  RedisBuffer.hpp
+//
+//  This file contains the bounded ring that holds RedisAdapter adds through an outage
+
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "RedisFields.hpp"
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  class RA_Buffer
+//
+//  A ring of stream entries waiting to be added, bounded by bytes and by entries - when
+//  an entry does not fit, the oldest entries are dropped to make room for it
+//
+//  The ring is one mapping, either anonymous memory or a file (shared with the page
+//  cache, so the entries outlive the process and a later RA_Buffer of the same size on
+//  the same file takes them over) - pages are only touched as the ring fills, so a
+//  generous limit costs nothing until an outage uses it
+//
+//  Entries are numbered in the order they were pushed, which lets a reader peek at a
+//  batch, send it, and pop just what it sent even if older entries were dropped meanwhile
+//
+//  Not thread safe, the owner serializes access
+//
+class RA_Buffer
+{
+public:
+  struct Entry
+  {
+    int64_t time;             //  nanoseconds, as RA_Time
+    uint32_t trim;            //  as RA_ArgsAdd
+    bool approximateTrim;
+    RA_Fields attrs;          //  in the order they were added, so a replay adds the same entry
+  };
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Construction / Destruction
+  //
+  //    maxBytes   : size of the ring, which bounds the bytes of its entries
+  //    maxEntries : limit of the number of entries, zero for none
+  //    path       : file to map, anonymous memory if empty
+  //
+  //  ok() is false if the ring could not be mapped
+  //
+  RA_Buffer(size_t maxBytes, uint32_t maxEntries, const std::string& path = "")
+    : _max_entries(maxEntries)
+  {
+    uint64_t capacity = maxBytes / ALIGN * ALIGN;
+    size_t total = sizeof(header) + capacity;
+    void* map = MAP_FAILED;
+
+    if (path.empty())
+    {
+      map = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    else
+    {
+      int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+      struct stat st;
+      if (fd < 0 || fstat(fd, &st) || ((size_t)st.st_size != total && ftruncate(fd, total)))
+      {
+        syslog(LOG_ERR, "RA_Buffer %s: %s", path.c_str(), strerror(errno));
+        if (fd >= 0) close(fd);
+        return;
+      }
+      map = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);   //  the mapping keeps the file
+    }
+    if (map == MAP_FAILED) { syslog(LOG_ERR, "RA_Buffer mmap: %s", strerror(errno)); return; }
+
+    _head = (header*)map;
+    _data = (char*)map + sizeof(header);
+    _size = total;
+
+    //  take over the entries of a ring the same size, anything else starts empty
+    if (memcmp(_head->magic, MAGIC, sizeof(MAGIC)) || _head->capacity != capacity)
+    {
+      if (_head->magic[0]) syslog(LOG_WARNING, "RA_Buffer %s: not a ring of this size, discarded", path.c_str());
+      memset(_head, 0, sizeof(header));
+      memcpy(_head->magic, MAGIC, sizeof(MAGIC));
+      _head->capacity = capacity;
+    }
+  }
+
+  RA_Buffer(const RA_Buffer&) = delete;
+  RA_Buffer& operator=(const RA_Buffer&) = delete;
+
+  ~RA_Buffer() { if (_head) munmap(_head, _size); }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  ok      : true if the ring is mapped
+  //  entries : number of entries in the ring
+  //  bytes   : bytes of the entries in the ring
+  //  last    : time of the newest entry ever pushed (kept when the ring empties)
+  //
+  bool ok() const { return _head != nullptr; }
+
+  size_t entries() const { return _head->count; }
+
+  size_t bytes() const { return _head->used; }
+
+  int64_t last() const { return _head->last; }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  push : add an entry as the newest, dropping the oldest entries to make room
+  //
+  //    entry   : the entry to add
+  //    dropped : incremented for each entry dropped
+  //    return  : true if added, false if the entry is bigger than the whole ring
+  //
+  bool push(const Entry& entry, uint64_t& dropped)
+  {
+    uint64_t size = record_size(entry);
+    if (size > _head->capacity) { dropped++; return false; }
+
+    while (_head->count && ((_max_entries && _head->count >= _max_entries) || ! fits(size)))
+      { remove(); dropped++; }
+
+    //  a record does not wrap - when it would, mark the rest of the ring unused and go to zero
+    if (_head->tail >= _head->head && _head->capacity - _head->tail < size)
+    {
+      if (_head->tail < _head->capacity) put<uint32_t>(_head->tail, 0);
+      _head->tail = 0;
+    }
+    write(_head->tail, entry, size);
+
+    _head->tail += size;
+    _head->count++;
+    _head->used += size;
+    _head->last = entry.time;
+    return true;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  peek : copy the oldest entries
+  //  pop  : remove the oldest entries up to a number
+  //
+  //    count  : most entries to copy
+  //    out    : where to copy them to
+  //    seq    : number after the last entry to remove (the number returned by peek plus
+  //             the number of entries it copied)
+  //    return : number of the oldest entry
+  //
+  uint64_t peek(size_t count, std::vector<Entry>& out) const
+  {
+    uint64_t pos = _head->head;
+    for (uint64_t i = 0; i < count && i < _head->count; i++)
+    {
+      uint32_t size = next(pos);
+      out.push_back(read(pos));
+      pos += size;
+    }
+    return _head->first;
+  }
+
+  void pop(uint64_t seq) { while (_head->count && _head->first < seq) { remove(); } }
+
+private:
+  static constexpr char MAGIC[8] = { 'R', 'A', 'B', 'U', 'F', '0', '0', '1' };
+  static constexpr uint64_t ALIGN = 8;    //  records and capacity, so a wrap mark always fits
+
+  //  at the start of the mapping, the ring follows it
+  struct header
+  {
+    char magic[8];
+    uint64_t capacity;      //  bytes of the ring
+    uint64_t head;          //  offset of the oldest record
+    uint64_t tail;          //  offset after the newest record
+    uint64_t count;         //  records in the ring
+    uint64_t used;          //  bytes of the records in the ring
+    uint64_t first;         //  number of the oldest record
+    int64_t last;           //  time of the newest record pushed
+  };
+
+  //  a record is its size (zero marks the end of the used part of the ring), trim, time,
+  //  approximateTrim, the number of attrs, then the length of each field and value
+  //  followed by their bytes
+  static constexpr uint64_t RECORD_HEADER = 4 + 4 + 8 + 4 + 4;
+
+  template<typename T> void put(uint64_t pos, T val) { memcpy(_data + pos, &val, sizeof(T)); }
+  template<typename T> T get(uint64_t pos) const { T val; memcpy(&val, _data + pos, sizeof(T)); return val; }
+
+  static uint64_t record_size(const Entry& entry)
+  {
+    uint64_t size = RECORD_HEADER;
+    for (const auto& attr : entry.attrs) { size += 8 + attr.first.size() + attr.second.size(); }
+    return (size + ALIGN - 1) / ALIGN * ALIGN;
+  }
+
+  //  true if a record of size fits without removing any
+  bool fits(uint64_t size) const
+  {
+    const header& h = *_head;
+    if (h.count == 0) return true;
+    if (h.tail > h.head) return h.capacity - h.tail >= size || h.head >= size;
+    return h.head - h.tail >= size;   //  tail == head is full
+  }
+
+  //  size of the record at pos, moving pos to zero past the end of the used part
+  uint32_t next(uint64_t& pos) const
+  {
+    uint32_t size = pos < _head->capacity ? get<uint32_t>(pos) : 0;
+    if (size == 0) { pos = 0; size = get<uint32_t>(0); }
+    return size;
+  }
+
+  void remove()
+  {
+    uint64_t pos = _head->head;
+    uint32_t size = next(pos);
+    _head->head = pos + size;
+    _head->used -= size;
+    _head->first++;
+    if (--_head->count == 0) { _head->head = _head->tail = 0; }
+  }
+
+  void write(uint64_t pos, const Entry& entry, uint64_t size)
+  {
+    put<uint32_t>(pos, size);
+    put<uint32_t>(pos + 4, entry.trim);
+    put<int64_t>(pos + 8, entry.time);
+    put<uint32_t>(pos + 16, entry.approximateTrim);
+    put<uint32_t>(pos + 20, entry.attrs.size());
+    pos += RECORD_HEADER;
+    for (const auto& attr : entry.attrs)
+    {
+      put<uint32_t>(pos, attr.first.size());
+      put<uint32_t>(pos + 4, attr.second.size());
+      memcpy(_data + pos + 8, attr.first.data(), attr.first.size());
+      memcpy(_data + pos + 8 + attr.first.size(), attr.second.data(), attr.second.size());
+      pos += 8 + attr.first.size() + attr.second.size();
+    }
+  }
+
+  Entry read(uint64_t pos) const
+  {
+    Entry entry{ get<int64_t>(pos + 8), get<uint32_t>(pos + 4), get<uint32_t>(pos + 16) != 0, {} };
+    uint32_t num = get<uint32_t>(pos + 20);
+    entry.attrs.reserve(num);
+    pos += RECORD_HEADER;
+    for (uint32_t i = 0; i < num; i++)
+    {
+      uint32_t flen = get<uint32_t>(pos), vlen = get<uint32_t>(pos + 4);
+      entry.attrs.emplace_back(std::string(_data + pos + 8, flen), std::string(_data + pos + 8 + flen, vlen));
+      pos += 8 + flen + vlen;
+    }
+    return entry;
+  }
+
+  header* _head = nullptr;
+  char* _data = nullptr;
+  size_t _size = 0;
+  uint32_t _max_entries;
+};
@@ -1,13 +1,19 @@
 #pragma once
 
-#include <shared_mutex>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+#include <memory>
 #include <map>
 #include <unordered_map>
 #include <variant>
 #include <string>
 #include <vector>
 #include <array>
+#include <algorithm>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
 #include "spanCpp14.hpp"
 #include <semaphore>
 #include "RedisAdapter.hpp"
@@ -16,45 +22,214 @@ template<typename Type>
 class RedisCache {
 private:
     std::atomic<bool> newValueAvailable{false}; // Atomic flag for signaling new values
+    std::atomic<uint64_t> writeSequence{0};     // Number of writes so far, waiters wait for it to change
+    std::mutex waitMutex;                       // Guards the flag and sequence changes the waiters wait on
+    std::condition_variable waitCondition;      // Wakes the waiters on every write
     std::shared_ptr<RedisAdapter> _ra;
-    // The implementation of this cache has a potential flaw where if we have multiple readers contantly reading, then we could potentally stop new data from ever being
-    // written and as a side effect lock up the stream reader. If we ever actually use that we should think through implementing that sanely. Boost has an implementaion of queued
-    // locking that would prevent this, but then we'd have to pull in boost or part of it, with redis adapter.
-    mutable std::shared_mutex swapMutex; // Mutex that prevents swapping which buffer is for reading and writing.
-                                         // This mutex allows for simultanious reads, but prevents reading while writing.
-
-    int readIndex = 0;
-    std::array<std::vector<Type>, 2> buffers;
-    RA_Time lastWrite = 0;
+
+public:
+    // The cached data and the time it was written, never changed while anyone can see it
+    struct Frame {
+        RA_Time time;
+        std::vector<Type> data;
+    };
+    // The latest frames, oldest first, never changed once published
+    using History = std::vector<std::shared_ptr<const Frame>>;
+
+private:
+    // Frames the writer fills again once nobody else holds them, so a steady stream of writes of
+    // the same size reuses the same few data buffers instead of allocating one per write - the
+    // history holds depth of them, the rest are for readers still holding older frames
+    static constexpr size_t MAX_POOLED_FRAMES = 4;
+    std::vector<std::shared_ptr<Frame>> framePool;
+    size_t nextPooled = 0;                      // where to look first, frames come free oldest first
+
+    // The latest frames - the writer fills new frames and swaps in a new history holding them,
+    // readers take a reference to whichever history or frame is current and copy from it, so a reader
+    // never holds anything the writer waits on and the writer never waits for readers to finish
+    // (a frame lives until its last reader lets go) - latest is the last frame of history, kept
+    // apart so the common read of just the latest frame touches one shared count - both are only
+    // accessed through std::atomic_load/atomic_store (std::atomic<std::shared_ptr> needs C++20)
+    const size_t _depth;
+    mutable std::shared_ptr<const History> history;
+    mutable std::shared_ptr<const Frame> latest;
     std::string _subkey;
 
     void writeBuffer(const RedisAdapter::TimeValList<std::vector<Type>>& entry)
     {
-        const std::vector<Type>& data = entry.front().second;
-        int writeIndex = (readIndex + 1 ) % 2;
-
-        buffers.at(writeIndex) = data;
+        if (entry.empty()) { return; }
 
+        // entries come oldest first, only the last depth of them can stay
+        History added;
+        auto first = entry.size() > _depth ? entry.end() - _depth : entry.begin();
+        for (auto item = first; item != entry.end(); item++)
         {
-            // take an exclusive lock, so a reader can't read, while the buffers are being swapped
-            std::lock_guard<std::shared_mutex> swapLock(swapMutex);
-            readIndex = (readIndex + 1 ) % 2;
-            lastWrite = entry.front().first;
+            std::shared_ptr<Frame> frame = unusedFrame();
+            frame->time = item->first;
+            frame->data.assign(item->second.begin(), item->second.end());
+            added.push_back(std::move(frame));
         }
+        std::shared_ptr<const History> past = std::atomic_load(&history);
+        while (!std::atomic_compare_exchange_weak(&history, &past, merged(past ? *past : History(), added))) {}   // loadHistory may race
+        std::atomic_store(&latest, added.back());
+
         // Effectivly does nothing if the code using this class doesn't ever try to read this.
-        // Set the atomic flag to indicate that new data is available
-        newValueAvailable.store(true);
+        // Set the atomic flag to indicate that new data is available and wake any waiters,
+        // the change is made under the wait mutex so a waiter can't miss it between its check and its wait
+        {
+            std::lock_guard<std::mutex> waitLock(waitMutex);
+            writeSequence.fetch_add(1);
+            newValueAvailable.store(true);
+        }
+        waitCondition.notify_all();
+    }
+
+    // A pooled frame only the pool holds (not in the history, not held by a reader, and nobody can get
+    // it again) or, if readers hold them all, a new frame that is pooled if there is room
+    std::shared_ptr<Frame> unusedFrame()
+    {
+        for (size_t i = 0; i < framePool.size(); i++)
+        {
+            size_t idx = (nextPooled + i) % framePool.size();
+            if (framePool[idx].use_count() == 1)
+            {
+                std::atomic_thread_fence(std::memory_order_acquire);   // see the last reader's release
+                nextPooled = idx + 1;
+                return framePool[idx];
+            }
+        }
+        auto frame = std::make_shared<Frame>();
+        if (framePool.size() < _depth + MAX_POOLED_FRAMES) { framePool.push_back(frame); }
+        return frame;
+    }
+
+    // The newest depth frames of older followed by newer, less any of older not before the first of newer
+    std::shared_ptr<const History> merged(const History& older, const History& newer) const
+    {
+        auto ret = std::make_shared<History>();
+        ret->reserve(_depth);
+        auto end = newer.empty() ? older.end() : std::partition_point(older.begin(), older.end(),
+            [&](const auto& frame) { return frame->time.value < newer.front()->time.value; });
+        size_t keep = std::min<size_t>(end - older.begin(), _depth - std::min(_depth, newer.size()));
+        ret->insert(ret->end(), end - keep, end);
+        ret->insert(ret->end(), newer.end() - std::min(_depth, newer.size()), newer.end());
+        return ret;
+    }
+
+    // Fill the history with the newest depth entries in one request, keeping any frames the writer
+    // published meanwhile (they are newer) - if there is no data nothing changes and the next read tries again
+    void loadHistory() const
+    {
+        History loaded;
+        for (auto& item : _ra->getListsBefore<Type>(_subkey, { .count = (uint32_t)_depth }))
+        {
+            auto frame = std::make_shared<Frame>();
+            frame->time = item.first;
+            frame->data = std::move(item.second);
+            loaded.push_back(std::move(frame));
+        }
+        if (loaded.empty()) { return; }
+
+        std::shared_ptr<const History> current = std::atomic_load(&history);
+        std::shared_ptr<const History> next;
+        do { next = merged(loaded, current ? *current : History()); }   // the written frames are newer
+        while (!std::atomic_compare_exchange_weak(&history, &current, next));
+
+        std::shared_ptr<const Frame> none;
+        std::atomic_compare_exchange_strong(&latest, &none, next->back());   // keep one the writer published meanwhile
+    }
+
+    // The latest frame, or if the cache has no data yet an empty frame with time 0
+    std::shared_ptr<const Frame> currentFrame() const
+    {
+        std::shared_ptr<const Frame> frame = std::atomic_load(&latest);
+        if (frame) { return frame; }
+
+        loadHistory();
+        frame = std::atomic_load(&latest);
+        return frame ? frame : std::make_shared<const Frame>();
+    }
+
+    // The frames published so far, loading them if there are none yet
+    std::shared_ptr<const History> currentHistory() const
+    {
+        std::shared_ptr<const History> frames = std::atomic_load(&history);
+        if (frames && !frames->empty()) { return frames; }
+
+        loadHistory();
+        frames = std::atomic_load(&history);
+        return frames ? frames : std::make_shared<const History>();
     }
     void registerCacheReader() {
         //Setup redis setting readers
-        _ra->addListsReader<Type>(_subkey, [this](const std::string& base, const std::string& sub, const RedisAdapter::TimeValList<std::vector<Type>>& entry) {
+        _ra->addListsReader<Type>(_subkey, [this](const std::string&, const std::string&, const RedisAdapter::TimeValList<std::vector<Type>>& entry) {
             writeBuffer(entry);
-        });
+        }, "", this);
     }
 
 public:
     // Returns time that the last buffer was written
 
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  snapshot : Shares the latest frame without copying it
+    //
+    //    return : the frame, which does not change while it is held however long that is (the time in it
+    //             is that of the last data written to the redis stream, or 0 if there is no data at that key)
+    //
+    //  Later writes go to other frames, a held frame only goes back to the writer once it is let go
+    //
+    std::shared_ptr<const Frame> snapshot() const {
+        return currentFrame();
+    }
+
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  snapshotAt : Shares the frame at or before a time without copying it
+    //  copyAt     : Copies the data of the frame at or before a time to destBuffer
+    //
+    //    time       : time to find the frame for, the frame is the newest one not after it
+    //    destBuffer : Vector to copy the frame's data to, left alone if there is no such frame
+    //    return     : the frame (nullptr if the history has none that old), or its time (0 if none)
+    //
+    //  Only the frames in the history can be found, so the oldest findable time is that of the
+    //  oldest of the last depth writes
+    //
+    std::shared_ptr<const Frame> snapshotAt(RA_Time time) const {
+        std::shared_ptr<const History> frames = currentHistory();
+
+        auto after = std::partition_point(frames->begin(), frames->end(),
+            [&](const auto& frame) { return frame->time.value <= time.value; });
+        if (after == frames->begin()) { return nullptr; }
+        return *(after - 1);
+    }
+    RA_Time copyAt(RA_Time time, std::vector<Type>& destBuffer) const {
+        std::shared_ptr<const Frame> frame = snapshotAt(time);
+        if (!frame) { return RA_Time(); }
+
+        destBuffer = frame->data;
+        return frame->time;
+    }
+
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  latestN  : Shares the newest frames without copying them
+    //  frames   : Shares the whole history, e.g. to iterate over it
+    //  depth    : Number of frames the history holds when full
+    //
+    //    num    : most frames to share
+    //    return : the frames oldest first, none if the cache has no data
+    //
+    //  The history shared by frames() does not change while it is held, later writes make new ones
+    //
+    History latestN(size_t num) const {
+        std::shared_ptr<const History> frames = currentHistory();
+        return History(frames->end() - std::min(num, frames->size()), frames->end());
+    }
+    std::shared_ptr<const History> frames() const {
+        return currentHistory();
+    }
+    size_t depth() const {
+        return _depth;
+    }
+
     //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
     //  copyReadBuffer : Copies the data in the cache to destBuffer
     //
@@ -62,20 +237,12 @@ public:
     //    return     : time of the last data written to the redis stream, or 0 if there is data at that key
     //
     RA_Time copyReadBuffer(std::vector<Type>& destBuffer) {
-        // Take a shared lock, so other readers can still read, but the writer cannot swap the buffers
-        std::shared_lock<std::shared_mutex> swapLock(swapMutex);
+        std::shared_ptr<const Frame> frame = currentFrame();
 
-        // If the cache has no data read in whatever's there to initilize the cache.
-        if (!lastWrite.ok())
-        {
-            lastWrite = _ra->getSingleList(_subkey, buffers.at(readIndex));
-        }
-
-        std::vector<Type>& sourceBuffer = buffers.at(readIndex);
         // Copy internel buffer to user
-        destBuffer = sourceBuffer;
+        destBuffer = frame->data;
 
-        return lastWrite;
+        return frame->time;
     }
 
     //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -93,41 +260,83 @@ public:
     }
     RA_Time copyReadBuffer(std::span<Type> destBuffer, int firstIndexToCopy = 0 , int* pElementsCopied = nullptr)
     {
-        // Take a shared lock, so other readers can still read, but the writer cannot swap the buffers
-        std::shared_lock<std::shared_mutex> swapLock(swapMutex);
-
-        // If the cache has no data read in whatever's there to initilize the cache.
-        if (!lastWrite.ok())
-        {
-            lastWrite = _ra->getSingleList(_subkey, buffers.at(readIndex));
-        }
+        std::shared_ptr<const Frame> frame = currentFrame();
+        const std::vector<Type>& sourceBuffer = frame->data;
 
-        std::vector<Type>& sourceBuffer = buffers.at(readIndex);
-
-        typename std::vector<Type>::iterator copySourceStart = sourceBuffer.begin() + firstIndexToCopy;
-        typename std::vector<Type>::iterator copySourceEnd   = copySourceStart + destBuffer.size();
-
-        if (copySourceEnd > sourceBuffer.end())
-            { copySourceEnd = sourceBuffer.end(); }
-
-        if (copySourceStart >= sourceBuffer.end()) {
-           *pElementsCopied = 0;
+        if (firstIndexToCopy < 0 || (size_t)firstIndexToCopy >= sourceBuffer.size()) {
+           if (pElementsCopied != nullptr)
+               { *pElementsCopied = 0; }
            return RA_Time(); // Return an invalid time, and don't copy anything
         }
 
+        auto copySourceStart = sourceBuffer.begin() + firstIndexToCopy;
+        auto copySourceEnd   = copySourceStart + std::min(destBuffer.size(), (size_t)(sourceBuffer.end() - copySourceStart));
+
         auto elementAfterLastCopied = std::copy(copySourceStart, copySourceEnd, destBuffer.begin());
         if (pElementsCopied != nullptr)
             { *pElementsCopied = elementAfterLastCopied - destBuffer.begin(); }
 
-        return lastWrite;
+        return frame->time;
     }
-    void waitForNewValueMilis(int millisecondsBeweenChecks) {
-        waitForNewValue(std::chrono::milliseconds(millisecondsBeweenChecks));
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  waitForNewValue    : Blocks until new data is available, then clears the flag
+    //  waitForNewValueFor : As above, for at most timeout
+    //  waitUntil          : As above, until at most deadline
+    //
+    //    timeout  : longest time to wait
+    //    deadline : time to stop waiting at
+    //    return   : sequence number of the latest write, or 0 if the wait timed out (the flag is then left alone)
+    //
+    //  The writer wakes the waiters as soon as it has swapped the buffers
+    //
+    uint64_t waitForNewValue() {
+        std::unique_lock<std::mutex> waitLock(waitMutex);
+        waitCondition.wait(waitLock, [this] { return newValueAvailable.load(); });
+        newValueAvailable.store(false);
+        return writeSequence.load();
+    }
+    template <typename Rep, typename Period>
+    uint64_t waitForNewValueFor(std::chrono::duration<Rep, Period> timeout) {
+        return waitUntil(std::chrono::steady_clock::now() + timeout);
+    }
+    template <typename Clock, typename Duration>
+    uint64_t waitUntil(std::chrono::time_point<Clock, Duration> deadline) {
+        std::unique_lock<std::mutex> waitLock(waitMutex);
+        if (!waitCondition.wait_until(waitLock, deadline, [this] { return newValueAvailable.load(); }))
+            { return 0; }
+        newValueAvailable.store(false);
+        return writeSequence.load();
     }
 
-    // Take care of the template for the default case
-    void waitForNewValue() {
-        waitForNewValue(std::chrono::milliseconds(1)); // Call template with default argument
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  sequence        : Number of writes to the cache so far
+    //  waitForSequence : Blocks until there has been a write after the one numbered seen, for at most timeout
+    //
+    //    seen    : sequence number the caller has already handled, e.g. from sequence() or a previous wait
+    //    timeout : longest time to wait
+    //    return  : sequence number of the latest write, or 0 if the wait timed out
+    //
+    //  Unlike the flag, the sequence number is not cleared by waiting, so any number of threads can wait
+    //  on the same cache without taking the new value from each other
+    //
+    uint64_t sequence() const {
+        return writeSequence.load();
+    }
+    template <typename Rep, typename Period>
+    uint64_t waitForSequence(uint64_t seen, std::chrono::duration<Rep, Period> timeout) {
+        std::unique_lock<std::mutex> waitLock(waitMutex);
+        if (!waitCondition.wait_for(waitLock, timeout, [this, seen] { return writeSequence.load() > seen; }))
+            { return 0; }
+        return writeSequence.load();
+    }
+
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  waitForNewValueMilis, waitForNewValue(timeBetweenChecks) : Polling waits, kept for compatibility
+    //
+    //    timeBetweenChecks : time to sleep between checks of the flag
+    //
+    void waitForNewValueMilis(int millisecondsBeweenChecks) {
+        waitForNewValue(std::chrono::milliseconds(millisecondsBeweenChecks));
     }
     template <typename Rep, typename Period>
     void waitForNewValue(std::chrono::duration<Rep, Period> timeBetweenChecks) {
@@ -145,9 +354,20 @@ public:
         newValueAvailable.store(false);
     }
 
-    RedisCache(std::shared_ptr<RedisAdapter> ra, std::string subkey) { _ra = ra; _subkey = subkey; registerCacheReader(); }
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  Construction
+    //
+    //    ra     : adapter to read the stream through
+    //    subkey : sub key of the list stream to cache
+    //    depth  : number of the latest frames to keep for snapshotAt, copyAt, latestN and frames (at least 1)
+    //
+    //  The history is loaded with the last depth entries of the stream in one request, destruction
+    //  removes only the reader this cache added
+    //
+    RedisCache(std::shared_ptr<RedisAdapter> ra, std::string subkey, size_t depth = 1)
+        : _ra(ra), _depth(std::max<size_t>(depth, 1)), _subkey(subkey) { registerCacheReader(); loadHistory(); }
 
-    ~RedisCache() = default;
+    ~RedisCache() { _ra->removeReader(_subkey, "", this); }
 
     // Disabling copy and move operations
     RedisCache(const RedisCache&) = delete;
@@ -155,3 +375,154 @@ public:
     RedisCache(RedisCache&&) = delete;
     RedisCache& operator=(RedisCache&&) = delete;
 };
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  class RedisValueCache
+//
+//  The latest value of a value stream (Type is trivial, string or Attrs), the counterpart of
+//  RedisCache for settings that are single values rather than lists
+//
+//  A trivial value of up to 16 bytes is kept with its time in a seqlock - a read never takes a
+//  lock or touches a shared count, it copies the few words and retries only if a write overlapped,
+//  which suits reading settings in a tight control loop; other values are published as immutable
+//  frames through a shared_ptr swapped atomically, as RedisCache does
+//
+template<typename Type>
+class RedisValueCache {
+public:
+    // True if reads are lock free
+    static constexpr bool lockFree = std::is_trivially_copyable_v<Type> && sizeof(Type) <= 16;
+
+    // The cached value and the time it was written
+    struct Frame {
+        RA_Time time;
+        Type value;
+    };
+
+private:
+    // A frame in words that are each written and read atomically - a writer makes the sequence odd
+    // while it stores them, a reader takes them only if the sequence was even and unchanged throughout
+    class alignas(64) SeqFrame {
+        static_assert(std::is_trivially_copyable_v<Frame>, "frame copied as words");
+        static constexpr size_t WORDS = (sizeof(Frame) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        std::atomic<uint64_t> seq{0};
+        std::array<std::atomic<uint64_t>, WORDS> words{};
+
+    public:
+        void store(const Frame& frame) {
+            uint64_t buf[WORDS] = {};
+            std::memcpy(buf, &frame, sizeof(Frame));
+
+            uint64_t begin = seq.load(std::memory_order_relaxed);
+            seq.store(begin + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (size_t i = 0; i < WORDS; i++) { words[i].store(buf[i], std::memory_order_relaxed); }
+            seq.store(begin + 2, std::memory_order_release);
+        }
+        Frame load() const {
+            uint64_t buf[WORDS];
+            for (;;) {
+                uint64_t begin = seq.load(std::memory_order_acquire);
+                if (begin & 1) { continue; }   // a write is under way, it is only a few stores
+                for (size_t i = 0; i < WORDS; i++) { buf[i] = words[i].load(std::memory_order_relaxed); }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq.load(std::memory_order_relaxed) == begin) { break; }
+            }
+            Frame frame;
+            std::memcpy(&frame, buf, sizeof(Frame));
+            return frame;
+        }
+    };
+
+    std::shared_ptr<RedisAdapter> _ra;
+    std::string _subkey;
+    std::string _baseKey;
+
+    // The latest frame, no frame (time 0) until the key has data - a shared_ptr only accessed
+    // through std::atomic_load and std::atomic_store (std::atomic<std::shared_ptr> needs C++20)
+    std::conditional_t<lockFree, SeqFrame, std::shared_ptr<const Frame>> latest;
+    std::atomic<uint64_t> writeSequence{0};     // Number of writes so far
+
+    // Writers are the reader callback and the load on construction, which may race it
+    std::mutex writeMutex;
+    RA_Time lastTime;
+
+    void writeValue(RA_Time time, const Type& value)
+    {
+        std::lock_guard<std::mutex> writeLock(writeMutex);
+        if (time.value <= lastTime.value) { return; }   // keep a newer value the other writer stored
+        lastTime = time;
+
+        if constexpr (lockFree) { latest.store(Frame{ time, value }); }
+        else { std::atomic_store(&latest, std::make_shared<const Frame>(Frame{ time, value })); }
+        writeSequence.fetch_add(1);
+    }
+
+public:
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  read           : Copies the latest frame
+    //  copyReadValue  : Copies the latest value to destValue
+    //  snapshot       : Shares the latest frame without copying it (not for lock free values)
+    //
+    //    destValue : Value to copy the cached value to, left alone if there is no value yet
+    //    return    : the frame (time 0 if there is no data at that key), or its time (0 if none)
+    //
+    Frame read() const {
+        if constexpr (lockFree) { return latest.load(); }
+        else {
+            std::shared_ptr<const Frame> frame = std::atomic_load(&latest);
+            return frame ? *frame : Frame{};
+        }
+    }
+    RA_Time copyReadValue(Type& destValue) const {
+        if constexpr (lockFree) {
+            Frame frame = latest.load();
+            if (frame.time.ok()) { destValue = frame.value; }
+            return frame.time;
+        }
+        else {
+            std::shared_ptr<const Frame> frame = std::atomic_load(&latest);
+            if (!frame) { return RA_Time(); }
+            destValue = frame->value;
+            return frame->time;
+        }
+    }
+    std::shared_ptr<const Frame> snapshot() const {
+        static_assert(!lockFree, "lock free values are read with read or copyReadValue");
+        std::shared_ptr<const Frame> frame = std::atomic_load(&latest);
+        return frame ? frame : std::make_shared<const Frame>();
+    }
+
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  sequence : Number of writes to the cache so far, a loop can compare it to skip unchanged values
+    //
+    uint64_t sequence() const {
+        return writeSequence.load();
+    }
+
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  Construction / Destruction
+    //
+    //    ra      : adapter to read the stream through
+    //    subkey  : sub key of the value stream to cache
+    //    baseKey : base key of the stream, the adapter's own if empty
+    //
+    //  The latest value is loaded on construction, destruction removes only the reader this cache
+    //  added, others on the key keep reading
+    //
+    RedisValueCache(std::shared_ptr<RedisAdapter> ra, std::string subkey, std::string baseKey = "")
+        : _ra(ra), _subkey(subkey), _baseKey(baseKey)
+    {
+        _ra->addValuesReader<Type>(_subkey, [this](const std::string&, const std::string&, const RedisAdapter::TimeValList<Type>& entry) {
+            if (!entry.empty()) { writeValue(entry.back().first, entry.back().second); }
+        }, _baseKey, this);
+        Type value{};
+        RA_Time time = _ra->getSingleValue<Type>(_subkey, value, { .baseKey = _baseKey });
+        if (time.ok()) { writeValue(time, value); }
+    }
+
+    ~RedisValueCache() { _ra->removeReader(_subkey, _baseKey, this); }
+
+    RedisValueCache(const RedisValueCache&) = delete;
+    RedisValueCache& operator=(const RedisValueCache&) = delete;
+};
@@ -0,0 +1,237 @@
+//
+//  RedisCacheManager.hpp
+//
+//  This file contains the cache of the latest lists of many stream keys under one memory budget
+
+#pragma once
+
+#include <list>
+#include <unordered_set>
+#include "RedisCache.hpp"
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  class RedisCacheManager
+//
+//  The latest frame of any number of list streams under one base key, for when a RedisCache per
+//  key would be thousands of reader registrations (each restarting the reader threads) holding
+//  their data forever
+//
+//  A key is cached from its first read on, getting its data from redis then and from its reader
+//  after - when the cached bytes go over the budget, the least recently read keys are dropped
+//  (a dropped key's reader stays, its data is ignored until it is read again)
+//
+//  watch() registers the readers of many keys at once, a key read without being watched gets
+//  its reader on that first read
+//
+//  All keys share one mutex, held only to look up, reorder and swap frames, never across a
+//  request to redis or a copy of data
+//
+template<typename Type>
+class RedisCacheManager {
+public:
+    using Frame = typename RedisCache<Type>::Frame;
+
+    struct Stats {
+        uint64_t hits;          // reads of a cached key
+        uint64_t misses;        // reads that got the key from redis
+        uint64_t evictions;     // keys dropped to stay under the budget
+        size_t entries;         // keys cached now
+        size_t bytes;           // bytes the cached keys count against the budget now
+    };
+
+private:
+    struct Entry {
+        std::shared_ptr<const Frame> frame;             // null until loaded, a read then asks redis again
+        size_t bytes = 0;
+        std::list<const std::string*>::iterator lru;    // place in lruOrder
+    };
+
+    std::shared_ptr<RedisAdapter> _ra;
+    std::string _baseKey;
+    const size_t _budget;
+
+    std::mutex cacheMutex;                              // guards everything below
+    std::unordered_map<std::string, Entry> entries;
+    std::list<const std::string*> lruOrder;             // keys of entries, most recently read first
+    std::unordered_set<std::string> watched;            // keys with a reader
+    size_t cachedBytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+
+    static const std::shared_ptr<const Frame>& noFrame() {
+        static const std::shared_ptr<const Frame> none = std::make_shared<const Frame>();
+        return none;
+    }
+
+    // What an entry counts against the budget, roughly what it holds on the heap
+    static size_t entryBytes(const std::string& subKey, const std::shared_ptr<const Frame>& frame) {
+        return sizeof(Entry) + sizeof(const std::string*) + subKey.size()
+             + (frame ? sizeof(Frame) + frame->data.size() * sizeof(Type) : 0);
+    }
+
+    // Drop the least recently read entries until the cache fits the budget, except keep (lock held)
+    void evict(const std::string* keep) {
+        auto it = lruOrder.end();
+        while (cachedBytes > _budget && it != lruOrder.begin()) {
+            if (*--it == keep) { continue; }
+            auto victim = entries.find(**it);
+            it = lruOrder.erase(it);
+            cachedBytes -= victim->second.bytes;
+            entries.erase(victim);
+            evictions++;
+        }
+    }
+
+    // Swap in a frame for a cached key if it is newer than the one there (lock held)
+    //   return : the key's frame after, or frame if the key is not cached
+    std::shared_ptr<const Frame> storeFrame(const std::string& subKey, std::shared_ptr<const Frame> frame) {
+        auto it = entries.find(subKey);
+        if (it == entries.end()) { return frame; }
+
+        Entry& entry = it->second;
+        if (entry.frame && entry.frame->time.value >= frame->time.value) { return entry.frame; }
+
+        size_t bytes = entryBytes(subKey, frame);
+        cachedBytes = cachedBytes - entry.bytes + bytes;
+        entry.bytes = bytes;
+        entry.frame = std::move(frame);
+        evict(&it->first);
+        return entry.frame;
+    }
+
+    bool addReader(const std::string& subKey) {
+        return _ra->addListsReader<Type>(subKey, [this, subKey](const std::string&, const std::string&, const RedisAdapter::TimeValList<std::vector<Type>>& entry) {
+            if (entry.empty()) { return; }
+            {
+                std::lock_guard<std::mutex> lock(cacheMutex);
+                if (entries.count(subKey) == 0) { return; }   // not cached, nothing to copy
+            }
+            auto frame = std::make_shared<Frame>();
+            frame->time = entry.back().first;
+            frame->data = entry.back().second;
+
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            storeFrame(subKey, std::move(frame));
+        }, _baseKey, this);
+    }
+
+public:
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  Construction / Destruction
+    //
+    //    ra      : adapter to read the streams through
+    //    budget  : most bytes the cached keys may hold, a key bigger than that alone is still cached
+    //    baseKey : base key of the streams, the adapter's own if empty
+    //
+    //  Destruction removes only the readers this manager added, others on its keys keep reading
+    //
+    RedisCacheManager(std::shared_ptr<RedisAdapter> ra, size_t budget, std::string baseKey = "")
+        : _ra(ra), _baseKey(baseKey), _budget(budget) {}
+
+    ~RedisCacheManager() {
+        _ra->setDeferReaders(true);
+        for (const auto& subKey : watched) { _ra->removeReader(subKey, _baseKey, this); }
+        _ra->setDeferReaders(false);
+    }
+
+    RedisCacheManager(const RedisCacheManager&) = delete;
+    RedisCacheManager& operator=(const RedisCacheManager&) = delete;
+
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  watch : Registers the readers of many keys at once, restarting the reader threads once
+    //
+    //    subKeys : sub keys to read, those already watched are skipped
+    //    return  : true if every reader was added
+    //
+    //  Readers are deferred for the duration (see RedisAdapter::setDeferReaders), nothing is read
+    //  from redis until a key is first read through the manager
+    //
+    bool watch(const std::vector<std::string>& subKeys) {
+        std::vector<std::string> added;
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            for (const auto& subKey : subKeys) { if (watched.insert(subKey).second) { added.push_back(subKey); } }
+        }
+        if (added.empty()) { return true; }
+
+        bool ok = _ra->setDeferReaders(true);
+        std::vector<std::string> failed;
+        for (const auto& subKey : added) { if (!addReader(subKey)) { failed.push_back(subKey); } }
+        ok = _ra->setDeferReaders(false) && ok;
+
+        if (failed.empty()) { return ok; }
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        for (const auto& subKey : failed) { watched.erase(subKey); }   // a read or watch tries again
+        return false;
+    }
+
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  snapshot       : Shares the latest frame of a key without copying it
+    //  copyReadBuffer : Copies the latest data of a key to destBuffer
+    //
+    //    subKey     : sub key to read
+    //    destBuffer : Vector to copy the data to
+    //    return     : the frame (time 0 and no data if there is no data at that key), or its time
+    //
+    //  A key that is not cached is cached from now on, the read then waits for its data from redis -
+    //  so does a read of a key whose data could not be had yet (no data at the key, or redis failed),
+    //  which counts as a miss again rather than a hit on nothing
+    //
+    std::shared_ptr<const Frame> snapshot(const std::string& subKey) {
+        bool needReader;
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            auto it = entries.find(subKey);
+            if (it != entries.end() && it->second.frame) {
+                hits++;
+                lruOrder.splice(lruOrder.begin(), lruOrder, it->second.lru);
+                return it->second.frame;
+            }
+            misses++;
+            if (it != entries.end()) {
+                // not loaded yet (the last request failed or found no data), ask again
+                lruOrder.splice(lruOrder.begin(), lruOrder, it->second.lru);
+            }
+            else {
+                // cached before the request, so the reader keeps any newer data that arrives meanwhile
+                it = entries.emplace(subKey, Entry()).first;
+                lruOrder.push_front(&it->first);
+                it->second.lru = lruOrder.begin();
+                it->second.bytes = entryBytes(subKey, nullptr);
+                cachedBytes += it->second.bytes;
+                evict(&it->first);
+            }
+            needReader = watched.insert(subKey).second;
+        }
+        if (needReader && !addReader(subKey)) {
+            syslog(LOG_ERR, "RedisCacheManager: failed to add reader for %s", subKey.c_str());
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            watched.erase(subKey);   // the next read tries again
+        }
+
+        auto frame = std::make_shared<Frame>();
+        frame->time = _ra->getSingleList(subKey, frame->data, { .baseKey = _baseKey });
+        if (!frame->time.ok()) { return noFrame(); }
+
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        return storeFrame(subKey, std::move(frame));
+    }
+    RA_Time copyReadBuffer(const std::string& subKey, std::vector<Type>& destBuffer) {
+        std::shared_ptr<const Frame> frame = snapshot(subKey);
+        destBuffer = frame->data;
+        return frame->time;
+    }
+
+    //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+    //  stats  : Counts of reads and evictions so far, and what is cached now
+    //  budget : Most bytes the cached keys may hold
+    //
+    Stats stats() {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        return { hits, misses, evictions, entries.size(), cachedBytes };
+    }
+    size_t budget() const {
+        return _budget;
+    }
+};
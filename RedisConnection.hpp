@@ -1,12 +1,45 @@
 #pragma once
 
 #include "sw/redis++/redis++.h"
+#include "RedisFields.hpp"
 #include <syslog.h>
 #include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <sstream>
+#include <cstring>
+#include <charconv>
+#include <condition_variable>
 
 namespace swr = sw::redis;
 namespace chr = std::chrono;
 
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  parse : redis++ reply parser for RA_Fields, found by argument dependent lookup
+//
+//  Lets the stream reads below fill RA_Fields straight from the flat field/value array
+//  of each entry, the same as they would an unordered_map
+//
+inline RA_Fields parse(swr::reply::ParseTag<RA_Fields>, redisReply& reply)
+{
+  if ( ! swr::reply::is_array(reply)) { throw swr::ProtoError("Expect ARRAY reply"); }
+  if (reply.elements % 2) { throw swr::ProtoError("Not string pair array reply"); }
+
+  RA_Fields ret;
+  ret.reserve(reply.elements / 2);
+  for (size_t idx = 0; idx < reply.elements; idx += 2)
+  {
+    if (reply.element[idx] == nullptr || reply.element[idx + 1] == nullptr)
+      { throw swr::ProtoError("Null field reply"); }
+
+    ret.emplace_back(swr::reply::parse<std::string>(*reply.element[idx]),
+                     swr::reply::parse<std::string>(*reply.element[idx + 1]));
+  }
+  return ret;
+}
+
 //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
 //  class RedisConnection
 //
@@ -28,7 +61,33 @@ public:
   //    timeout  : connection and blocking read timeout
   //    port     : port server is listening on
   //    size     : connection pool size
+  //    sharded  : use sharded pub/sub (SPUBLISH/SSUBSCRIBE) when connected to a cluster
+  //    blocking : max dedicated blocking read connections, outside the command pool
+  //               (zero means no limit, i.e. one per blocking reader)
+  //    topology : milliseconds between refreshes of the cluster slot map (zero means
+  //               only refresh when a pipeline is redirected by MOVED or ASK)
+  //    shards   : "host:port" of independent single servers to spread base keys over
+  //               (empty means connect to host/port or path only, see connect())
+  //    mode     : the server type to connect as, see Mode below
+  //    lazy     : skip the PING when connecting as a single server, so no connection is
+  //               made until the first command (a dead server then fails on first use)
+  //    readFrom : where stream range reads go on a cluster, see ReadFrom below
+  //    staleness: max replica lag in milliseconds for a replica to serve reads, checked
+  //               at each slot map refresh (zero means no bound)
+  //
+  //  Mode::AUTO                : use the type last found at this host:port (or path) by any
+  //                              connection in the process, else try cluster then single
+  //  Mode::SINGLE              : single server only, no cluster attempt
+  //  Mode::CLUSTER             : cluster only, no single server fallback
+  //
+  //  ReadFrom::MASTER          : all reads go to the masters
+  //  ReadFrom::PREFER_REPLICA  : reads go to a replica of the key's master if one is within
+  //                              the staleness bound (and answers), else to the master
+  //  ReadFrom::REPLICA         : reads go to a replica within the staleness bound or fail
   //
+  enum class Mode { AUTO, SINGLE, CLUSTER };
+  enum class ReadFrom { MASTER, PREFER_REPLICA, REPLICA };
+
   struct Options
   {
     std::string path;
@@ -38,7 +97,46 @@ public:
     uint32_t timeout = 500;   //  milliseconds
     uint16_t port = 6379;
     uint16_t size = 5;
+    std::vector<std::string> shards;
+    Mode mode = Mode::AUTO;
+    bool lazy = false;
+    bool sharded = true;
+    uint16_t blocking = 0;
+    uint32_t topology = 5000;   //  milliseconds
+    ReadFrom readFrom = ReadFrom::MASTER;
+    uint32_t staleness = 0;     //  milliseconds
+  };
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  struct RedisConnection::BlockingStats
+  //
+  //    open     : dedicated blocking connections currently leased
+  //    leases   : total leases granted
+  //    waits    : leases that had to wait for a connection (Options::blocking reached)
+  //    timeouts : waits that gave up without a connection
+  //    wait     : total time spent waiting for leases
+  //    max_wait : longest single wait for a lease
+  //
+  struct BlockingStats
+  {
+    uint32_t open = 0;
+    uint64_t leases = 0;
+    uint64_t waits = 0;
+    uint64_t timeouts = 0;
+    chr::nanoseconds wait{0};
+    chr::nanoseconds max_wait{0};
+  };
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Blocker : lease on a dedicated blocking read connection (see blocker() below),
+  //            the connection is closed and the lease returned when it is destroyed
+  //
+  struct blocker_release
+  {
+    RedisConnection* conn = nullptr;
+    void operator()(swr::Redis* redis) const { delete redis; conn->release_lease(); }
   };
+  using Blocker = std::unique_ptr<swr::Redis, blocker_release>;
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  RedisConnection : store connection options and attempt to connect
@@ -65,6 +163,17 @@ public:
   //
   RedisConnection(RedisConnection&&) = delete;
 
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  ~RedisConnection : free the current clients and any retired by connect()
+  //
+  //  no method may still be running on another thread when this is called
+  //
+  ~RedisConnection()
+  {
+    delete _clients.exchange(nullptr);
+    for (auto& old : _retired) delete old.second;
+  }
+
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  connect : attempt to make either a cluster or single server connection
   //
@@ -72,6 +181,14 @@ public:
   //    return : true if live server connected
   //             false if not connected
   //
+  //  Which type is tried first is up to Options::mode - with AUTO, the first connection to
+  //  an endpoint probes for a cluster and the rest in the process go straight to the type
+  //  found (see s_modes below)
+  //
+  //  If Options::shards lists servers, each is connected as a single server and keys are
+  //  spread over them by their cluster slot on a consistent hash ring (see ring_topology())
+  //  - all servers must answer for the connection to succeed
+  //
   bool connect(const Options& opts)
   {
     swr::ConnectionOptions co;
@@ -95,34 +212,74 @@ public:
 
     cpo.size = opts.size;
 
-    //  build the new client(s) into locals first, then swap them into the shared
-    //  _cluster/_singler under a brief lock - every other method takes its own
-    //  brief lock just to copy these shared_ptrs before using them (see snapshot()
-    //  below), so the old client object stays alive (via the old shared_ptr's
-    //  refcount) for as long as any in-flight call is still using it, even after
-    //  we replace _cluster/_singler here - this avoids both the original bug
-    //  (destroying a live client out from under a concurrent caller) and a
-    //  reader/writer-lock starvation problem (a lock held for the entire duration
-    //  of a blocking redis call can starve a writer under continuous read traffic)
+    //  build the new client(s) into locals first, then publish them as a whole new
+    //  clients object - every other method reads the published pointer without a lock
+    //  inside an epoch (see snapshot() below), so the old clients object is retired
+    //  rather than deleted and stays alive for as long as any in-flight call could
+    //  still be using it - this avoids both destroying a live client out from under
+    //  a concurrent caller and holding any lock for the duration of a redis call
     std::shared_ptr<swr::RedisCluster> cluster;
     std::shared_ptr<swr::Redis> singler;
 
-    try { cluster = std::make_shared<swr::RedisCluster>(co, cpo); }  //  this one throws
-    catch (...)
+    std::shared_ptr<const topology> topo;
+
+    _read_from = opts.readFrom;
+    _staleness = opts.staleness;
+
+    if (opts.shards.size())
     {
+      std::vector<std::shared_ptr<swr::Redis>> servers;
       try
       {
-        singler = std::make_shared<swr::Redis>(co, cpo);   //  this one does not
-        singler->ping();                                   //  but this one does
+        for (const auto& shard : opts.shards)
+        {
+          servers.push_back(std::make_shared<swr::Redis>(at_node(co, shard), cpo));
+          if ( ! opts.lazy) servers.back()->ping();
+        }
+        topo = ring_topology(opts.shards, servers);
+        singler = servers.front();   //  for calls without a key (pub/sub)
+      }
+      catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
+    }
+    else
+    {
+      //  a failed cluster attempt costs a connection and a round trip, so in AUTO mode
+      //  try the type this endpoint had last time first, and only probe if that fails
+      std::string endpoint = is_unix_socket ? co.path : co.host + ":" + std::to_string(co.port);
+      Mode first = opts.mode;
+      if (first == Mode::AUTO)
+      {
+        std::lock_guard<std::mutex> lk(s_mode_mtx);
+        auto it = s_modes.find(endpoint);
+        if (it != s_modes.end()) first = it->second;
+      }
+      bool try_single  = opts.mode != Mode::CLUSTER;
+      bool try_cluster = opts.mode != Mode::SINGLE;
+
+      if (try_single && first == Mode::SINGLE) singler = single_client(co, cpo, opts.lazy);
+      if (try_cluster && ! singler) cluster = cluster_client(co, cpo, topo);
+      if (try_single && first != Mode::SINGLE && ! cluster) singler = single_client(co, cpo, opts.lazy);
+
+      if (opts.mode == Mode::AUTO && (cluster || singler))
+      {
+        std::lock_guard<std::mutex> lk(s_mode_mtx);
+        s_modes[endpoint] = cluster ? Mode::CLUSTER : Mode::SINGLE;
       }
-      catch (...) { singler.reset(); }   //  reset singler to null since not really connected
     }
 
     {
       std::lock_guard<std::mutex> lk(_mtx);
-      _cluster = cluster;
-      _singler = singler;
+      auto next = new clients{ cluster, singler, topo, co, cpo };
+      retire(_clients.exchange(next));
+    }
+    _topo_ms = opts.topology;
+    {
+      std::lock_guard<std::mutex> lk(_blk_mtx);
+      _blk_max = opts.blocking;
     }
+    _blk_cv.notify_all();
+    //  sharded pub/sub needs the slot map to find the node serving each channel
+    _sharded = opts.sharded && cluster && topo && topo->slots.size();
 
     //  a live server is connected, either cluster OR singler is valid (but not both)
     if (cluster || singler) return true;
@@ -144,7 +301,7 @@ public:
   //
   bool ping(const std::string& key = "ping")
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(key);
     try
     {
       if (cluster) return cluster->redis(key, false).ping().compare("PONG") == 0;
@@ -164,7 +321,7 @@ public:
   //
   int32_t del(const std::string& key)
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(key);
     try
     {
       if (cluster) return cluster->del(key);
@@ -177,6 +334,8 @@ public:
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  xrange : read a forward-id-ordered (newest last) list of elements from a stream
   //
+  //  xrange and xrevrange go to a replica if Options::readFrom says so (see read() below)
+  //
   //    key    : the stream to read
   //    beg    : the lowest id to read (subject to cnt)
   //    end    : the highest id to read
@@ -189,14 +348,7 @@ public:
   bool xrange(const std::string& key, const std::string& beg,
               const std::string& end, uint32_t cnt, Output out)
   {
-    auto [cluster, singler] = snapshot();
-    try
-    {
-      if (cluster) { cluster->xrange(key, beg, end, cnt, out); return true; }
-      if (singler) { singler->xrange(key, beg, end, cnt, out); return true; }
-    }
-    catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
-    return false;
+    return read(__func__, key, [&](auto& redis) { redis.xrange(key, beg, end, cnt, out); });
   }
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -213,14 +365,7 @@ public:
   bool xrange(const std::string& key, const std::string& beg,
               const std::string& end, Output out)
   {
-    auto [cluster, singler] = snapshot();
-    try
-    {
-      if (cluster) { cluster->xrange(key, beg, end, out); return true; }
-      if (singler) { singler->xrange(key, beg, end, out); return true; }
-    }
-    catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
-    return false;
+    return read(__func__, key, [&](auto& redis) { redis.xrange(key, beg, end, out); });
   }
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -238,14 +383,7 @@ public:
   bool xrevrange(const std::string& key, const std::string& end,
                  const std::string& beg, uint32_t cnt, Output out)
   {
-    auto [cluster, singler] = snapshot();
-    try
-    {
-      if (cluster) { cluster->xrevrange(key, end, beg, cnt, out); return true; }
-      if (singler) { singler->xrevrange(key, end, beg, cnt, out); return true; }
-    }
-    catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
-    return false;
+    return read(__func__, key, [&](auto& redis) { redis.xrevrange(key, end, beg, cnt, out); });
   }
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -262,14 +400,7 @@ public:
   bool xrevrange(const std::string& key, const std::string& end,
                  const std::string& beg, Output out)
   {
-    auto [cluster, singler] = snapshot();
-    try
-    {
-      if (cluster) { cluster->xrevrange(key, end, beg, out); return true; }
-      if (singler) { singler->xrevrange(key, end, beg, out); return true; }
-    }
-    catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
-    return false;
+    return read(__func__, key, [&](auto& redis) { redis.xrevrange(key, end, beg, out); });
   }
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -289,7 +420,7 @@ public:
   template<typename Input, typename Output>
   bool xreadMultiBlock(Input fst, Input lst, uint32_t tmo, Output out)
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(fst != lst ? std::string(fst->first) : std::string());
     try
     {
       if (cluster) { cluster->xread(fst, lst, chr::milliseconds(tmo), out); return true; }
@@ -300,6 +431,98 @@ public:
     return false;
   }
 
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  xreadMultiBlock : as above, but on a dedicated connection leased from blocker()
+  //
+  //    blk    : the dedicated connection to read on, must serve the slot of the keys
+  //    return : true if read (or timed out)
+  //             false if blk is empty or the read failed (blk is then released)
+  //
+  //  This keeps a blocking read from holding a command pool connection for up to tmo
+  //
+  //  Unlike a read through the cluster client, blk does not follow MOVED or ASK - when a
+  //  read fails (the node failed over, gave up the slot or dropped the connection) the slot
+  //  map is reread, so the next blocker() for the keys goes to the node serving them now
+  //
+  template<typename Input, typename Output>
+  bool xreadMultiBlock(Blocker& blk, Input fst, Input lst, uint32_t tmo, Output out)
+  {
+    if ( ! blk) return false;
+    try
+    {
+      blk->xread(fst, lst, chr::milliseconds(tmo), out);
+      return true;
+    }
+    catch (const swr::TimeoutError&) { return true; }
+    catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
+    blk.reset();
+    refresh_topology();
+    return false;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  blocker : lease a dedicated connection for blocking reads, outside the command pool
+  //
+  //    key    : a key to be read, on a cluster the connection goes to the master serving it
+  //    tmo    : milliseconds to wait if Options::blocking connections are already leased
+  //    return : the leased connection if successful
+  //             empty if not connected or none became free within tmo
+  //
+  //  The connection's socket timeout is twice Options::timeout so that a blocking read of
+  //  up to Options::timeout returns from the server before the socket gives up on it
+  //
+  Blocker blocker(const std::string& key, uint32_t tmo)
+  {
+    auto t0 = chr::steady_clock::now();
+    {
+      std::unique_lock<std::mutex> lk(_blk_mtx);
+      if (_blk_max && _blk_stats.open >= _blk_max)
+      {
+        _blk_stats.waits++;
+        bool got = _blk_cv.wait_for(lk, chr::milliseconds(tmo), [this]() { return ! _blk_max || _blk_stats.open < _blk_max; });
+        auto waited = chr::steady_clock::now() - t0;
+        _blk_stats.wait += waited;
+        _blk_stats.max_wait = std::max<chr::nanoseconds>(_blk_stats.max_wait, waited);
+        if ( ! got) { _blk_stats.timeouts++; return Blocker(nullptr, blocker_release{this}); }
+      }
+      _blk_stats.open++;
+      _blk_stats.leases++;
+    }
+    Blocker blk(nullptr, blocker_release{this});
+
+    epoch_guard eg;
+    const clients* cur = _clients.load();
+    try
+    {
+      if (cur && cur->cluster)
+      {
+        std::string node = cur->topo ? slot_node(cur->topo->slots, key) : "";
+        if (node.empty()) { blk.reset(new swr::Redis(cur->cluster->redis(key, true))); }
+        else              { blk.reset(new swr::Redis(dedicated(cur->co, node), single_pool())); }
+      }
+      else if (cur && cur->singler)
+      {
+        std::string node = cur->topo ? slot_node(cur->topo->slots, key) : "";   //  sharded servers
+        blk.reset(new swr::Redis(dedicated(cur->co, node), single_pool()));
+      }
+    }
+    catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
+
+    if ( ! blk) release_lease();   //  the deleter only releases a lease that has a connection
+    return blk;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  blockingStats : lease and wait time metrics for the dedicated blocking connections
+  //
+  //    return : a copy of the current stats
+  //
+  BlockingStats blockingStats()
+  {
+    std::lock_guard<std::mutex> lk(_blk_mtx);
+    return _blk_stats;
+  }
+
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  xadd : add an element to the specified stream
   //
@@ -313,7 +536,7 @@ public:
   template<typename Input>
   std::string xadd(const std::string& key, const std::string& id, Input fst, Input lst)
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(key);
     try
     {
       if (cluster) return cluster->xadd(key, id, fst, lst);
@@ -334,7 +557,7 @@ public:
   //
   int32_t xtrim(const std::string& key, uint32_t thr, bool apx = true)
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(key);
     try
     {
       if (cluster) return cluster->xtrim(key, thr, apx);
@@ -360,7 +583,7 @@ public:
   std::string xaddTrim(const std::string& key, const std::string& id,
                        Input fst, Input lst, uint32_t thr, bool apx = true)
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(key);
     try
     {
       if (cluster) return cluster->xadd(key, id, fst, lst, thr, apx);
@@ -370,6 +593,66 @@ public:
     return {};
   }
 
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  pipeline : send a batch of commands to a server in one round trip on one connection
+  //
+  //    key    : a key the commands use, on a cluster they must all be served by its node
+  //             (keys in different slots are fine as long as one master serves them all)
+  //    fill   : called with the swr::Pipeline to queue the commands on
+  //    done   : called with the swr::QueuedReplies, one reply per queued command in order
+  //             (QueuedReplies::get throws if that command's reply is an error)
+  //    reads  : true if every queued command is a read, which lets the batch go to a
+  //             replica per Options::readFrom (see node())
+  //    return : true if the batch was sent and done was called
+  //             false if unsuccessful or not connected (done is not called)
+  //
+  //  On a cluster the pipeline goes to the node the client side slot map (see node())
+  //  says serves key. If any command is redirected with MOVED or ASK (a failover or slot
+  //  migration) its reply is that error, and the slot map is refreshed afterwards so the
+  //  next pipeline goes to the right node - commands are never resent, since the rest of
+  //  the batch may already have been applied
+  //
+  template<typename Fill, typename Done>
+  bool pipeline(const std::string& key, Fill fill, Done done, bool reads = false)
+  {
+    epoch_guard eg;
+    const clients* cur = fresh();
+    bool moved = false;
+    auto exec = [&](swr::Pipeline pipe)
+    {
+      fill(pipe);
+      auto replies = pipe.exec();
+      moved = redirected(replies);
+      done(replies);
+      return true;
+    };
+    bool ret = false;
+    try
+    {
+      if (cur && cur->cluster)
+      {
+        bool master = true;
+        if (reads && _read_from != ReadFrom::MASTER)
+        {
+          //  a failed read batch is safe to resend, so PREFER_REPLICA falls back to the master
+          swr::Redis* rep = cur->topo ? node_client(*cur->topo, replica_node(*cur->topo, key)) : nullptr;
+          try { if (rep) ret = exec(rep->pipeline(false)); }
+          catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
+          master = ! ret && _read_from == ReadFrom::PREFER_REPLICA;
+        }
+        if (master)
+        {
+          swr::Redis* node = cur->topo ? node_client(*cur->topo, slot_node(cur->topo->slots, key)) : nullptr;
+          ret = node ? exec(node->pipeline(false)) : exec(cur->cluster->pipeline(key, false));
+        }
+      }
+      else if (cur && cur->singler) { ret = exec(server_for(*cur, key).pipeline(false)); }
+    }
+    catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
+    if (moved) refresh_topology();
+    return ret;
+  }
+
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  exists : test if a key exists
   //
@@ -380,7 +663,7 @@ public:
   //
   int32_t exists(const std::string& key)
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(key);
     try
     {
       if (cluster) return cluster->exists(key);
@@ -398,16 +681,45 @@ public:
   //             0 if connected to a single redis
   //            -1 if unsuccsessful or not connected
   //
+  //  The slot is computed locally (see hash_slot() below) rather than asking the server -
+  //  sharded single servers (Options::shards) have slots too, as they are spread by slot
+  //
   int32_t keyslot(const std::string& key)
   {
-    auto [cluster, singler] = snapshot();
-    try
+    epoch_guard eg;
+    const clients* cur = _clients.load();
+    if (cur && (cur->cluster || cur->topo)) return hash_slot(key);
+    if (cur && cur->singler) return 0;
+    return -1;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  hash_slot : compute the cluster slot for a key, per the cluster spec this is the
+  //              CRC16 (XMODEM) of the key's hash tag if it has one, else the whole key
+  //
+  //    key    : the key to find a slot for
+  //    return : the slot number (0 - 16383)
+  //
+  //    https://redis.io/docs/reference/cluster-spec/#hash-tags
+  //
+  static uint16_t hash_slot(const std::string& key)
+  {
+    size_t beg = 0, len = key.size();
+
+    size_t lft = key.find('{');
+    if (lft != std::string::npos)
     {
-      if (cluster) return cluster->command<long long>("cluster", "keyslot", key);
-      if (singler) return 0;
+      size_t rgt = key.find('}', lft + 1);
+      if (rgt != std::string::npos && rgt > lft + 1) { beg = lft + 1; len = rgt - beg; }
     }
-    catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
-    return -1;
+
+    uint16_t crc = 0;
+    for (size_t i = beg; i < beg + len; i++)
+    {
+      crc ^= (uint16_t)(uint8_t)key[i] << 8;
+      for (int bit = 0; bit < 8; bit++) { crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1; }
+    }
+    return crc & 16383;
   }
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -421,12 +733,14 @@ public:
   //            -2 if CROSSSLOT error
   //
   //  Note that this method will fail on a cluster unless src and dst hash to the same slot
+  //  (or on sharded single servers, unless they are on the same server - also -2)
   //    https://stackoverflow.com/questions/38042629/redis-cross-slot-error
   //    https://redis.io/docs/reference/cluster-spec/
   //
   int32_t copy(const std::string& src, const std::string& dst)
   {
-    auto [cluster, singler] = snapshot();
+    if ( ! same_server(src, dst)) return -2;
+    auto [cluster, singler] = snapshot(src);
     try
     {
       if (cluster) return cluster->command<long long>("copy", src, dst);
@@ -449,12 +763,18 @@ public:
   //             false if not connected
   //
   //  Note that this method will fail on a cluster unless src and dst hash to the same slot
+  //  (or on sharded single servers, unless they are on the same server)
   //    https://stackoverflow.com/questions/38042629/redis-cross-slot-error
   //    https://redis.io/docs/reference/cluster-spec/
   //
   bool rename(const std::string& src, const std::string& dst)
   {
-    auto [cluster, singler] = snapshot();
+    if ( ! same_server(src, dst))
+    {
+      syslog(LOG_ERR, "RedisConnection::%s %s and %s are on different servers", __func__, src.c_str(), dst.c_str());
+      return false;
+    }
+    auto [cluster, singler] = snapshot(src);
     try
     {
       if (cluster) { cluster->rename(src, dst); return true; }
@@ -471,7 +791,7 @@ public:
   //
   std::vector<std::string> time(const std::string& key = "time")
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(key);
     std::vector<std::string> ret;
     try
     {
@@ -493,7 +813,7 @@ public:
   //
   int32_t hexists(const std::string& key, const std::string& fld)
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(key);
     try
     {
       if (cluster) return cluster->hexists(key, fld);
@@ -514,7 +834,7 @@ public:
   //
   bool hset(const std::string& key, const std::string& fld, const std::string& val)
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(key);
     try
     {
       if (cluster) return cluster->hset(key, fld, val) >= 0;
@@ -539,7 +859,7 @@ public:
   //
   int32_t hexpire(const std::string& key, const std::string& fld, uint32_t sec)
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(key);
     std::vector<long long> ret;
     try
     {
@@ -572,7 +892,7 @@ public:
   //
    std::vector<std::string> hkeys(const std::string& key)
   {
-    auto [cluster, singler] = snapshot();
+    auto [cluster, singler] = snapshot(key);
     std::vector<std::string> ret;
     try
     {
@@ -586,24 +906,22 @@ public:
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //  subscriber : get a Subscriber object for pub/sub
   //
-  //    return : pointer to a Subscriber if successful
-  //             0 if unsuccessful or not connected
+  //    return : a Subscriber on its own (non-pooled) connection if successful
+  //             empty if unsuccessful or not connected
   //
-  //    note - previously this function returned std::optional<swr::Subscriber> but
-  //           std::optional has been replaced with swr::Optional to support c++14
-  //           and unfortunately swr::Optional cannot create an empty optional with
-  //           swr::Subscriber - now client must delete new swr::Subscriber when done
+  //    note - the Subscriber is not thread safe, the caller must confine all use
+  //           of it (subscribe, unsubscribe and consume) to a single thread
   //
-  swr::Subscriber* subscriber()
+  std::unique_ptr<swr::Subscriber> subscriber()
   {
     auto [cluster, singler] = snapshot();
     try
     {
-      if (cluster) { return new swr::Subscriber(cluster->subscriber()); }
-      if (singler) { return new swr::Subscriber(singler->subscriber()); }
+      if (cluster) { return std::make_unique<swr::Subscriber>(cluster->subscriber()); }
+      if (singler) { return std::make_unique<swr::Subscriber>(singler->subscriber()); }
     }
     catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
-    return 0;
+    return {};
   }
 
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -626,23 +944,659 @@ public:
     return -1;
   }
 
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  spublish : publish a message to a sharded pub/sub channel
+  //
+  //    chn    : the channel to publish to
+  //    msg    : the message to publish
+  //    return : >= 0 the number of subscribers notified
+  //             -1 if not connected
+  //
+  //  On a cluster this is SPUBLISH, which is only propagated within the shard that owns
+  //  the channel's slot, where PUBLISH is broadcast to every node in the cluster - on a
+  //  single server (or when sharding is not in use, see shard()) this is just PUBLISH
+  //
+  int32_t spublish(const std::string& chn, const std::string& msg)
+  {
+    auto [cluster, singler] = snapshot();
+    try
+    {
+      if (cluster) return _sharded ? cluster->spublish(chn, msg) : cluster->publish(chn, msg);
+      if (singler) return singler->publish(chn, msg);
+    }
+    catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
+    return -1;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  ssubscriber : get a Subscriber object for sharded pub/sub
+  //
+  //    chn    : a channel served by the node to connect to
+  //    return : a Subscriber connected to the node that owns the slot of chn
+  //             empty if unsuccessful, not connected or not a cluster
+  //
+  //    note - as with subscriber() the caller must confine all use to a single thread,
+  //           and can only ssubscribe channels served by that same node (see shard())
+  //
+  std::unique_ptr<swr::Subscriber> ssubscriber(const std::string& chn)
+  {
+    auto [cluster, singler] = snapshot();
+    try
+    {
+      if (cluster) { return std::make_unique<swr::Subscriber>(cluster->subscriber(chn)); }
+    }
+    catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); }
+    return {};
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  shard : find the node that serves a channel for sharded pub/sub
+  //
+  //    chn    : the channel to find a node for
+  //    return : "host:port" of the cluster master that owns the slot of chn
+  //             empty if classic pub/sub is in use (single server, Options::sharded
+  //             is false, cluster slots unknown or not connected)
+  //
+  std::string shard(const std::string& chn)
+  {
+    return _sharded ? node(chn) : std::string();
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  node : find the cluster node that serves a key from the client side slot map
+  //
+  //    key    : the key to find a node for
+  //    reads  : true to find the node a read of key goes to per Options::readFrom
+  //    return : "host:port" of the cluster master that owns the slot of key, or of the
+  //             replica chosen for reads
+  //             empty if single server, cluster slots unknown or not connected
+  //
+  //  The slot map is refreshed here if it is older than Options::topology, so callers
+  //  that partition a batch by node see the cluster as it is now (give or take a failover)
+  //
+  std::string node(const std::string& key, bool reads = false)
+  {
+    epoch_guard eg;
+    const clients* cur = fresh();
+    if ( ! cur || ! cur->topo) return {};
+    if (reads && _read_from != ReadFrom::MASTER)
+    {
+      std::string rep = replica_node(*cur->topo, key);
+      if (rep.size()) return rep;
+    }
+    return slot_node(cur->topo->slots, key);
+  }
+
 private:
   //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-  //  snapshot : copy the current _cluster/_singler shared_ptrs under a brief lock
+  //  slot_map : which cluster master (and replicas) serve each range of slots, sorted by first slot
   //
-  //  The lock is only held long enough to bump a refcount (a few instructions), never for
-  //  the duration of a redis call (which can block for hundreds of ms) - this is what lets
-  //  connect() safely swap in new clients without starving callers under continuous traffic,
-  //  while still guaranteeing the client object a caller obtains stays alive for the whole
-  //  call even if connect() replaces _cluster/_singler concurrently
+  struct slot_range { uint16_t beg; uint16_t end; std::string node; std::vector<std::string> replicas; };
+  using slot_map = std::vector<slot_range>;
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  slot_find : the range covering slot, null if none does
+  //  slot_node : the "host:port" of the master serving key, empty if no range covers it
   //
-  std::pair<std::shared_ptr<swr::RedisCluster>, std::shared_ptr<swr::Redis>> snapshot()
+  static const slot_range* slot_find(const slot_map& slots, uint16_t slot)
   {
-    std::lock_guard<std::mutex> lk(_mtx);
-    return { _cluster, _singler };
+    auto it = std::upper_bound(slots.begin(), slots.end(), slot,
+                               [](uint16_t s, const slot_range& r) { return s < r.beg; });
+
+    if (it == slots.begin() || slot > (--it)->end) return nullptr;
+    return &*it;
   }
 
-  std::mutex _mtx;
-  std::shared_ptr<swr::RedisCluster> _cluster;
-  std::shared_ptr<swr::Redis>        _singler;
+  static std::string slot_node(const slot_map& slots, const std::string& key)
+  {
+    const slot_range* range = slot_find(slots, hash_slot(key));
+    return range ? range->node : std::string();
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  at_node     : connection options for a connection to node ("" = as connected)
+  //  dedicated   : connection options for a blocking read connection to node
+  //  single_pool : pool options for a client with exactly one connection
+  //
+  static swr::ConnectionOptions at_node(swr::ConnectionOptions co, const std::string& node)
+  {
+    if (node.size())
+    {
+      size_t colon = node.rfind(':');
+      co.type = swr::ConnectionType::TCP;
+      co.host = node.substr(0, colon);
+      co.port = std::stoi(node.substr(colon + 1));
+    }
+    return co;
+  }
+
+  static swr::ConnectionOptions dedicated(swr::ConnectionOptions co, const std::string& node)
+  {
+    co.socket_timeout *= 2;
+    return at_node(co, node);
+  }
+
+  static swr::ConnectionPoolOptions single_pool()
+  {
+    swr::ConnectionPoolOptions cpo;
+    cpo.size = 1;
+    return cpo;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  release_lease : return a blocking connection lease and wake one waiter
+  //
+  void release_lease()
+  {
+    {
+      std::lock_guard<std::mutex> lk(_blk_mtx);
+      _blk_stats.open--;
+    }
+    _blk_cv.notify_one();
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Epoch based reclamation of the published clients
+  //
+  //  Every thread that calls into a RedisConnection owns one epoch_rec (on its own cache
+  //  line) in a process wide registry. While inside a call the record holds the global
+  //  epoch seen on entry, outside any call it holds 0. The hot path only writes the
+  //  calling thread's own record - no lock, no refcount and no shared cache line writes.
+  //
+  //  connect() (and refresh_topology()) swaps in a new clients object and retires the old
+  //  one stamped with a new epoch. A retired object is deleted once no thread is inside a
+  //  call that entered before it was retired, which is checked on each swap and in the
+  //  destructor - so a replaced clients object (and its connection pool) lives until the
+  //  next swap at most, or longer if a call that started before it was replaced is still running.
+  //
+  struct alignas(64) epoch_rec
+  {
+    std::atomic<uint64_t> epoch{0};   //  0 when the owning thread is not inside a call
+    std::atomic<bool> used{true};     //  false when free for a new thread to claim
+    epoch_rec* next = nullptr;        //  registry link, records are never freed
+    uint32_t depth = 0;               //  nested guards, only touched by the owner
+  };
+
+  inline static std::atomic<uint64_t>   s_epoch{1};
+  inline static std::atomic<epoch_rec*> s_recs{nullptr};
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  local_rec : this thread's epoch record, claimed on first use and released at thread exit
+  //
+  static epoch_rec& local_rec()
+  {
+    struct owner
+    {
+      epoch_rec* rec = nullptr;
+      owner()
+      {
+        for (epoch_rec* r = s_recs.load(); r && ! rec; r = r->next)
+        {
+          bool free = false;
+          if (r->used.compare_exchange_strong(free, true)) rec = r;
+        }
+        if ( ! rec)
+        {
+          rec = new epoch_rec;
+          rec->next = s_recs.load();
+          while ( ! s_recs.compare_exchange_weak(rec->next, rec));
+        }
+      }
+      ~owner() { rec->used = false; }
+    };
+    thread_local owner own;
+    return *own.rec;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  epoch_guard : marks this thread as inside a call for its lifetime
+  //
+  //  entering stores the current epoch (seq_cst) before the caller loads _clients, which
+  //  pairs with the exchange and epoch increment in connect() so that either connect()
+  //  sees this thread's epoch or this thread sees the new clients
+  //
+  struct epoch_guard
+  {
+    epoch_guard()
+    {
+      epoch_rec& rec = local_rec();
+      if (rec.depth++ == 0) rec.epoch.store(s_epoch.load());
+    }
+    ~epoch_guard()
+    {
+      epoch_rec& rec = local_rec();
+      if (--rec.depth == 0) rec.epoch.store(0, std::memory_order_release);
+    }
+    epoch_guard(const epoch_guard&) = delete;
+    epoch_guard& operator=(const epoch_guard&) = delete;
+  };
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  topology : the cluster slot map and a client for each master in it
+  //
+  //  The master clients carry pipelines only (everything else goes through the
+  //  RedisCluster, which follows redirects itself) and the replica clients (READONLY,
+  //  made only if Options::readFrom is not MASTER) carry reads. Their pools connect
+  //  lazily, so a node that is never used costs nothing. A refresh keeps the clients of
+  //  nodes that are still in the map.
+  //
+  struct topology
+  {
+    slot_map slots;
+    std::unordered_map<std::string, std::shared_ptr<swr::Redis>> nodes;   //  "host:port" -> client
+    std::unordered_map<std::string, bool> stale;                          //  replica -> beyond staleness
+    chr::steady_clock::time_point when;                                   //  when CLUSTER SLOTS was read
+  };
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  replica_node : the replica a read of key goes to, empty if none is fit to serve it
+  //
+  //  replicas of a master are spread over by slot, skipping any beyond the staleness bound
+  //
+  static std::string replica_node(const topology& topo, const std::string& key)
+  {
+    uint16_t slot = hash_slot(key);
+    const slot_range* range = slot_find(topo.slots, slot);
+    if ( ! range) return {};
+
+    size_t num = range->replicas.size();
+    for (size_t i = 0; i < num; i++)
+    {
+      const std::string& rep = range->replicas[(slot + i) % num];
+      auto it = topo.stale.find(rep);
+      if (it != topo.stale.end() && ! it->second && topo.nodes.count(rep)) return rep;
+    }
+    return {};
+  }
+
+  static swr::Redis* node_client(const topology& topo, const std::string& node)
+  {
+    auto it = topo.nodes.find(node);
+    return it == topo.nodes.end() ? nullptr : it->second.get();
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  clients : the client(s) made by one call to connect(), published as a unit
+  //
+  //  refresh_topology() publishes a copy with a new topology and the same clients
+  //
+  struct clients
+  {
+    std::shared_ptr<swr::RedisCluster> cluster;
+    std::shared_ptr<swr::Redis>        singler;
+    std::shared_ptr<const topology>    topo;    //  null unless cluster or sharded single servers
+    swr::ConnectionOptions             co;      //  used to make dedicated and node connections
+    swr::ConnectionPoolOptions         cpo;     //  used to make node connections
+  };
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  snapshot : the current cluster/singler, valid for the lifetime of the snapshot
+  //
+  //  used as  auto [cluster, singler] = snapshot(key);  at the top of every method - the
+  //  returned object is an epoch_guard, so the clients it points to cannot be deleted
+  //  until the method returns even if connect() replaces them concurrently
+  //
+  //  with sharded single servers singler is the server for key (the first server if no key)
+  //
+  struct snapshot_t : epoch_guard
+  {
+    swr::RedisCluster* cluster = nullptr;
+    swr::Redis*        singler = nullptr;
+
+    snapshot_t(const std::atomic<const clients*>& published, const std::string& key)
+    {
+      if (const clients* cur = published.load())
+      {
+        cluster = cur->cluster.get();
+        singler = cur->singler ? &server_for(*cur, key) : nullptr;
+      }
+    }
+  };
+
+  snapshot_t snapshot(const std::string& key = {}) const { return snapshot_t(_clients, key); }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  server_for : the single server for key - the one server, or with Options::shards the
+  //               server the ring puts key on (the first server if key is empty)
+  //  same_server : false if src and dst are on different sharded single servers
+  //
+  static swr::Redis& server_for(const clients& cur, const std::string& key)
+  {
+    if (cur.topo && key.size())
+    {
+      if (swr::Redis* server = node_client(*cur.topo, slot_node(cur.topo->slots, key))) return *server;
+    }
+    return *cur.singler;
+  }
+
+  bool same_server(const std::string& src, const std::string& dst) const
+  {
+    epoch_guard eg;
+    const clients* cur = _clients.load();
+    if ( ! cur || cur->cluster || ! cur->topo) return true;
+    return slot_node(cur->topo->slots, src) == slot_node(cur->topo->slots, dst);
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  retire : queue old clients for deletion and delete any no thread can still see
+  //
+  //  must hold _mtx
+  //
+  void retire(const clients* old)
+  {
+    if (old) _retired.emplace_back(s_epoch.fetch_add(1) + 1, old);
+
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (epoch_rec* r = s_recs.load(); r; r = r->next)
+    {
+      uint64_t e = r->epoch.load();
+      if (e && e < oldest) oldest = e;
+    }
+    auto keep = std::partition(_retired.begin(), _retired.end(),
+                               [oldest](const auto& old) { return old.first > oldest; });
+    for (auto it = keep; it != _retired.end(); ++it) delete it->second;
+    _retired.erase(keep, _retired.end());
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  read : run a read only command on a replica of key's master per Options::readFrom,
+  //         or on the cluster or single server
+  //
+  //    func   : the calling method's name, for the log
+  //    key    : the key read
+  //    cmd    : called with the client to run the command on (swr::Redis or RedisCluster)
+  //    return : true if the command ran, false if unsuccessful or not connected
+  //
+  //  with PREFER_REPLICA a read that fails on the replica is retried on the master, which
+  //  is safe because it has no side effects
+  //
+  template<typename Cmd>
+  bool read(const char* func, const std::string& key, Cmd cmd)
+  {
+    epoch_guard eg;
+    const clients* cur = fresh();
+    if (cur && cur->cluster && _read_from != ReadFrom::MASTER)
+    {
+      swr::Redis* rep = cur->topo ? node_client(*cur->topo, replica_node(*cur->topo, key)) : nullptr;
+      try { if (rep) { cmd(*rep); return true; } }
+      catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", func, e.what()); }
+      if (_read_from == ReadFrom::REPLICA) return false;
+    }
+    try
+    {
+      if (cur && cur->cluster) { cmd(*cur->cluster); return true; }
+      if (cur && cur->singler) { cmd(server_for(*cur, key)); return true; }
+    }
+    catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", func, e.what()); }
+    return false;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  fresh : the current clients, after refreshing the topology if it is older than
+  //          Options::topology - must be called inside an epoch_guard
+  //
+  const clients* fresh()
+  {
+    const clients* cur = _clients.load();
+    uint32_t ms = _topo_ms;
+    if (ms && cur && cur->cluster && cur->topo && chr::steady_clock::now() - cur->topo->when > chr::milliseconds(ms))
+    {
+      refresh_topology();
+      cur = _clients.load();
+    }
+    return cur;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  refresh_topology : reread CLUSTER SLOTS and publish it with the current clients
+  //
+  //  if connect() or another refresh already holds _mtx this returns right away - the
+  //  caller carries on with the map it has, which the other thread is about to replace
+  //
+  void refresh_topology()
+  {
+    std::unique_lock<std::mutex> lk(_mtx, std::try_to_lock);
+    if ( ! lk) return;
+
+    const clients* cur = _clients.load();   //  only replaced under _mtx, so stable here
+    if ( ! cur || ! cur->cluster) return;
+
+    auto topo = cluster_topology(*cur->cluster, cur->co, cur->cpo, cur->topo.get());
+    retire(_clients.exchange(new clients{ cur->cluster, cur->singler, topo, cur->co, cur->cpo }));
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  redirected : true if any reply in a pipeline is a MOVED or ASK redirection
+  //
+  static bool redirected(swr::QueuedReplies& replies)
+  {
+    for (size_t i = 0; i < replies.size(); i++)
+    {
+      try { replies.get(i); }
+      catch (const swr::RedirectionError&) { return true; }
+      catch (const swr::Error&) {}
+    }
+    return false;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  cluster_topology : build a topology from CLUSTER SLOTS
+  //
+  //    prev   : the topology being replaced (null if none) to reuse node clients from,
+  //             and to keep the slots of if CLUSTER SLOTS fails
+  //    return : the new topology, stamped now either way so a failure is retried
+  //             after Options::topology rather than on every call
+  //
+  std::shared_ptr<const topology> cluster_topology(swr::RedisCluster& cluster, const swr::ConnectionOptions& co,
+                                                   const swr::ConnectionPoolOptions& cpo, const topology* prev) const
+  {
+    auto topo = std::make_shared<topology>();
+    topo->when = chr::steady_clock::now();
+
+    try { topo->slots = cluster_slots(cluster); }
+    catch (const swr::Error& e)
+    {
+      syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what());
+      if (prev) topo->slots = prev->slots;
+    }
+    auto add_node = [&](const std::string& node, bool readonly)
+    {
+      auto& client = topo->nodes[node];
+      if (client) return;
+      if (prev && prev->nodes.count(node)) { client = prev->nodes.at(node); return; }
+      swr::ConnectionOptions nco = at_node(co, node);
+      nco.readonly = readonly;
+      client = std::make_shared<swr::Redis>(nco, cpo);
+    };
+    bool replicas = _read_from != ReadFrom::MASTER;
+    for (const auto& range : topo->slots)
+    {
+      add_node(range.node, false);
+      for (const auto& rep : range.replicas) { if (replicas) add_node(rep, true); }
+    }
+    if (replicas) replica_lag(*topo);
+    return topo;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  replica_lag : mark each replica in topo stale or not per Options::staleness
+  //
+  //  each master's INFO REPLICATION lists its replicas as
+  //    slave0:ip=10.0.0.2,port=6379,state=online,offset=1234,lag=0
+  //  where lag is whole seconds since the replica last acknowledged - a replica that is
+  //  not listed online (or whose master does not answer, or whose lag is unreadable) is stale
+  //
+  void replica_lag(topology& topo) const
+  {
+    uint32_t bound = _staleness;
+    for (const auto& range : topo.slots)
+    {
+      for (const auto& rep : range.replicas) { topo.stale[rep] = bound != 0; }
+    }
+    if ( ! bound) return;
+
+    std::unordered_map<std::string, bool> asked;
+    for (const auto& range : topo.slots)
+    {
+      if (range.replicas.empty() || asked[range.node]) continue;
+      asked[range.node] = true;
+
+      std::string info;
+      try { info = topo.nodes.at(range.node)->info("replication"); }
+      catch (const swr::Error& e) { syslog(LOG_ERR, "RedisConnection::%s %s", __func__, e.what()); continue; }
+
+      std::istringstream lines(info);
+      for (std::string line; std::getline(lines, line); )
+      {
+        if (line.compare(0, 5, "slave") || line.find("state=online") == std::string::npos) continue;
+
+        auto field = [&line](const char* name)
+        {
+          size_t beg = line.find(name);
+          if (beg == std::string::npos) return std::string();
+          beg += strlen(name);
+          return line.substr(beg, line.find_first_of(",\r", beg) - beg);
+        };
+        std::string node = field("ip=") + ":" + field("port=");
+        std::string lag = field("lag=");
+        uint64_t secs;
+        auto [end, err] = std::from_chars(lag.data(), lag.data() + lag.size(), secs);
+        if (err != std::errc() || end != lag.data() + lag.size()) continue;   //  unreadable lag stays stale
+        if (topo.stale.count(node)) topo.stale[node] = secs * 1000 > bound;
+      }
+    }
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  cluster_client : a cluster client and its topology, null if the server is not a cluster
+  //  single_client  : a single server client, null if lazy is false and it does not answer
+  //
+  std::shared_ptr<swr::RedisCluster> cluster_client(const swr::ConnectionOptions& co, const swr::ConnectionPoolOptions& cpo,
+                                                    std::shared_ptr<const topology>& topo) const
+  {
+    try
+    {
+      auto cluster = std::make_shared<swr::RedisCluster>(co, cpo);   //  this one throws
+      topo = cluster_topology(*cluster, co, cpo, nullptr);
+      return cluster;
+    }
+    catch (...) { return {}; }
+  }
+
+  static std::shared_ptr<swr::Redis> single_client(const swr::ConnectionOptions& co, const swr::ConnectionPoolOptions& cpo,
+                                                   bool lazy)
+  {
+    try
+    {
+      auto singler = std::make_shared<swr::Redis>(co, cpo);   //  this one does not throw
+      if ( ! lazy) singler->ping();                           //  but this one does
+      return singler;
+    }
+    catch (...) { return {}; }   //  null since not really connected
+  }
+
+  //  the server type last found at each endpoint, shared by every connection in the process
+  inline static std::mutex s_mode_mtx;
+  inline static std::unordered_map<std::string, Mode> s_modes;
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  ring_topology : spread the slots over independent single servers on a consistent hash ring
+  //
+  //    shards  : "host:port" of each server
+  //    servers : a client for each server, in the same order
+  //    return  : a topology whose slot map plays the part of CLUSTER SLOTS
+  //
+  //  Each server is put at RING_POINTS points on the ring of 16384 slots (the FNV-1a hash
+  //  of "host:port#n") and owns the slots up to and including each of its points. Keys
+  //  go by slot, so all the keys of a {baseKey} stay on one server, and adding or removing
+  //  one of N servers only moves about 1/N of the slots. The points depend only on the
+  //  set of names, so every process given the same servers (in any order) agrees.
+  //
+  static constexpr size_t RING_POINTS = 256;
+
+  static std::shared_ptr<const topology> ring_topology(const std::vector<std::string>& shards,
+                                                       const std::vector<std::shared_ptr<swr::Redis>>& servers)
+  {
+    auto fnv1a = [](const std::string& str)   //  with a murmur3 finalizer, as "name#n" differ by little
+    {
+      uint32_t hash = 2166136261u;
+      for (char c : str) { hash = (hash ^ (uint8_t)c) * 16777619u; }
+      hash ^= hash >> 16; hash *= 0x85ebca6bu; hash ^= hash >> 13; hash *= 0xc2b2ae35u; hash ^= hash >> 16;
+      return hash;
+    };
+
+    auto topo = std::make_shared<topology>();
+    topo->when = chr::steady_clock::now();
+
+    std::vector<std::pair<uint16_t, const std::string*>> points;   //  slot, server
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+      topo->nodes[shards[i]] = servers[i];
+      for (size_t n = 0; n < RING_POINTS; n++)
+        { points.emplace_back(fnv1a(shards[i] + "#" + std::to_string(n)) & 16383, &shards[i]); }
+    }
+    //  sort by name within a slot so collisions resolve the same way everywhere
+    std::sort(points.begin(), points.end(), [](const auto& a, const auto& b)
+      { return a.first != b.first ? a.first < b.first : *a.second < *b.second; });
+    points.erase(std::unique(points.begin(), points.end(), [](const auto& a, const auto& b)
+      { return a.first == b.first; }), points.end());
+
+    uint16_t beg = 0;
+    for (const auto& pt : points)
+    {
+      topo->slots.push_back({ beg, pt.first, *pt.second, {} });
+      beg = pt.first + 1;
+    }
+    if (beg < 16384) topo->slots.push_back({ beg, 16383, *points.front().second, {} });   //  wraps around
+    return topo;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  cluster_slots : build a slot_map from CLUSTER SLOTS
+  //
+  //    each reply element is [ first slot, last slot, [ master host, port, id ], [ replica host, port, id ]... ]
+  //
+  static slot_map cluster_slots(swr::RedisCluster& cluster)
+  {
+    slot_map slots;
+
+    auto reply = cluster.redis("slots", false).command("cluster", "slots");
+
+    if (reply && reply->type == REDIS_REPLY_ARRAY)
+    {
+      for (size_t i = 0; i < reply->elements; i++)
+      {
+        const redisReply* range = reply->element[i];
+        if (range->type != REDIS_REPLY_ARRAY || range->elements < 3) continue;
+
+        const redisReply* master = range->element[2];
+        if (master->type != REDIS_REPLY_ARRAY || master->elements < 2) continue;
+
+        auto name = [](const redisReply* node)
+          { return std::string(node->element[0]->str, node->element[0]->len) + ":" + std::to_string(node->element[1]->integer); };
+
+        slots.push_back({ (uint16_t)range->element[0]->integer, (uint16_t)range->element[1]->integer, name(master), {} });
+        for (size_t r = 3; r < range->elements; r++)
+        {
+          const redisReply* replica = range->element[r];
+          if (replica->type == REDIS_REPLY_ARRAY && replica->elements >= 2) slots.back().replicas.push_back(name(replica));
+        }
+      }
+    }
+    std::sort(slots.begin(), slots.end(), [](const slot_range& a, const slot_range& b) { return a.beg < b.beg; });
+    return slots;
+  }
+
+  std::mutex _mtx;                        //  serializes connect() and refresh_topology()
+  std::atomic<const clients*> _clients{nullptr};
+  std::vector<std::pair<uint64_t, const clients*>> _retired;   //  retire epoch, clients
+
+  std::mutex _blk_mtx;                    //  guards the blocking connection leases
+  std::condition_variable _blk_cv;
+  uint16_t _blk_max = 0;
+  BlockingStats _blk_stats;
+  std::atomic<bool> _sharded{false};
+  std::atomic<uint32_t> _topo_ms{0};      //  Options::topology
+  std::atomic<ReadFrom> _read_from{ReadFrom::MASTER};
+  std::atomic<uint32_t> _staleness{0};
 };
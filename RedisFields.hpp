@@ -0,0 +1,137 @@
+//
+//  RedisFields.hpp
+//
+//  This file contains the flat field container that holds the fields of a stream entry
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <initializer_list>
+#include <unordered_map>
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  class RA_Fields
+//
+//  The field/value pairs of a stream entry, in the order redis sent them
+//
+//  Nearly every entry has the one default field, so the first pair is held inline and
+//  only a second pair moves them all to the heap - an entry of one field costs no
+//  allocation beyond its strings (which are usually short enough for none either),
+//  where an unordered_map costs a bucket array and a node and hashes every lookup
+//
+//  Lookups are a linear search, which beats hashing for the few fields an entry has
+//
+//  Converts to and from Attrs (the unordered_map the public API uses)
+//
+class RA_Fields
+{
+public:
+  using Attrs = std::unordered_map<std::string, std::string>;
+
+  using value_type = std::pair<std::string, std::string>;
+  using allocator_type = std::allocator<value_type>;   //  lets redis++ tell it is not a vector
+  using size_type = size_t;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using iterator = value_type*;
+  using const_iterator = const value_type*;
+
+  RA_Fields() = default;
+
+  RA_Fields(std::initializer_list<value_type> fields)
+  {
+    reserve(fields.size());
+    for (const auto& field : fields) { emplace_back(field); }
+  }
+
+  template<typename Input> RA_Fields(Input first, Input last)
+  {
+    for ( ; first != last; ++first) { emplace_back(first->first, first->second); }
+  }
+
+  RA_Fields(const Attrs& attrs) : RA_Fields(attrs.begin(), attrs.end()) {}
+
+  operator Attrs() const { return Attrs(begin(), end()); }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Sequence access
+  //
+  size_t size() const { return _heap.empty() ? _inline : _heap.size(); }
+
+  bool empty() const { return size() == 0; }
+
+  iterator begin() { return _heap.empty() ? &_one : _heap.data(); }
+  iterator end() { return begin() + size(); }
+
+  const_iterator begin() const { return _heap.empty() ? &_one : _heap.data(); }
+  const_iterator end() const { return begin() + size(); }
+
+  value_type& operator[](size_t idx) { return begin()[idx]; }
+  const value_type& operator[](size_t idx) const { return begin()[idx]; }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  find  : the first pair with a field, end() if none
+  //  count : the number of pairs with a field
+  //
+  const_iterator find(std::string_view field) const
+  {
+    const_iterator it = begin();
+    for ( ; it != end(); ++it) { if (it->first == field) break; }
+    return it;
+  }
+
+  size_t count(std::string_view field) const
+  {
+    size_t ret = 0;
+    for (const auto& pair : *this) { if (pair.first == field) ret++; }
+    return ret;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  Modifiers
+  //
+  //  reserve only matters for more than one pair, which then all go straight to the heap
+  //
+  void reserve(size_t num) { if (num > 1) _heap.reserve(num); }
+
+  void clear() { _heap.clear(); _inline = false; }
+
+  template<typename... Args> value_type& emplace_back(Args&&... args)
+  {
+    if (_heap.empty() && ! _inline)
+    {
+      _one = value_type(std::forward<Args>(args)...);
+      _inline = true;
+      return _one;
+    }
+    value_type pair(std::forward<Args>(args)...);   //  args may refer to _one
+    if (_heap.empty())
+    {
+      _heap.reserve(2);
+      _heap.push_back(std::move(_one));
+      _inline = false;
+    }
+    return _heap.emplace_back(std::move(pair));
+  }
+
+  void push_back(const value_type& pair) { emplace_back(pair); }
+  void push_back(value_type&& pair) { emplace_back(std::move(pair)); }
+
+  bool operator==(const RA_Fields& other) const
+  {
+    if (size() != other.size()) return false;
+    for (size_t i = 0; i < size(); i++) { if ((*this)[i] != other[i]) return false; }
+    return true;
+  }
+  bool operator!=(const RA_Fields& other) const { return ! (*this == other); }
+
+private:
+  value_type _one;                  //  the only pair, while there is just one
+  bool _inline = false;             //  true if _one holds it
+  std::vector<value_type> _heap;    //  all the pairs, once there is more than one
+};
@@ -0,0 +1,278 @@
+//
+//  RedisFuture.hpp
+//
+//  This file contains the future/promise pair returned by the RedisAdapter *Async methods
+
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <functional>
+#include <condition_variable>
+#include <deque>
+
+#ifdef REDIS_ADAPTER_COROUTINES
+#include <coroutine>
+#endif
+
+template<typename T> class RA_Promise;
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  class RA_Future
+//
+//  The result of an asynchronous RedisAdapter operation - either wait for it with get()
+//  or have it delivered with then(), but not both (the value is moved out by whichever
+//  comes first)
+//
+//  Unlike std::future a completion function can be attached, which is what lets a
+//  single thread keep many operations in flight without blocking on each one
+//
+template<typename T> class RA_Future
+{
+public:
+  RA_Future() = default;
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  valid : true if this future came from a promise
+  //  ready : true if the result has been set
+  //
+  bool valid() const { return (bool)_state; }
+
+  bool ready() const
+  {
+    if ( ! _state) return false;
+    std::lock_guard<std::mutex> lk(_state->mtx);
+    return _state->done;
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  wait     : block until the result has been set
+  //  wait_for : block until the result has been set or the timeout expires
+  //
+  //    tmo    : how long to wait
+  //    return : true if the result has been set
+  //
+  void wait() const
+  {
+    std::unique_lock<std::mutex> lk(_state->mtx);
+    _state->cv.wait(lk, [this]() { return _state->done; });
+  }
+
+  template<typename Rep, typename Per>
+  bool wait_for(const std::chrono::duration<Rep, Per>& tmo) const
+  {
+    std::unique_lock<std::mutex> lk(_state->mtx);
+    return _state->cv.wait_for(lk, tmo, [this]() { return _state->done; });
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  get : block until the result has been set and return it
+  //
+  //    return : the result
+  //
+  T get()
+  {
+    std::unique_lock<std::mutex> lk(_state->mtx);
+    _state->cv.wait(lk, [this]() { return _state->done; });
+    return std::move(*_state->value);
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  then : call a function with the result once it is set
+  //
+  //    func : the function to call - if the result is already set it is called right away
+  //           on this thread, otherwise it is called on the thread that sets the result
+  //           (for RedisAdapter that is the hub's async thread or one of its fanout threads,
+  //           so keep it short and never get() another future in it, which waits on them)
+  //
+  void then(std::function<void(T)> func)
+  {
+    std::unique_lock<std::mutex> lk(_state->mtx);
+    if ( ! _state->done) { _state->then = std::move(func); return; }
+    lk.unlock();
+    func(std::move(*_state->value));
+  }
+
+#ifdef REDIS_ADAPTER_COROUTINES
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  operator co_await : suspend the calling coroutine until the result is set
+  //
+  //  No thread waits - the coroutine is resumed from then(), so if it was suspended it
+  //  resumes on the hub's async thread or one of its fanout threads (hand off to your own
+  //  executor for long work, and co_await other futures rather than get() them)
+  //
+  auto operator co_await()
+  {
+    struct awaiter
+    {
+      RA_Future fut;
+      std::optional<T> value;
+
+      bool await_ready() const { return fut.ready(); }
+
+      bool await_suspend(std::coroutine_handle<> handle)
+      {
+        return fut.park([this, handle](T val) { value = std::move(val); handle.resume(); });
+      }
+
+      T await_resume() { return value ? std::move(*value) : fut.get(); }
+    };
+    return awaiter{ *this, {} };
+  }
+#endif
+
+private:
+  friend class RA_Promise<T>;
+
+  //  set the then() function only if the result is not set yet, returns false if it is
+  bool park(std::function<void(T)> func)
+  {
+    std::lock_guard<std::mutex> lk(_state->mtx);
+    if (_state->done) return false;
+    _state->then = std::move(func);
+    return true;
+  }
+
+  struct state
+  {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::optional<T> value;
+    std::function<void(T)> then;
+    bool done = false;
+  };
+  std::shared_ptr<state> _state;
+
+  RA_Future(std::shared_ptr<state> st) : _state(std::move(st)) {}
+};
+
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  class RA_Promise
+//
+//  The producing side of an RA_Future - copies share the same result, which must be set once
+//
+template<typename T> class RA_Promise
+{
+public:
+  RA_Promise() : _state(std::make_shared<typename RA_Future<T>::state>()) {}
+
+  RA_Future<T> future() const { return RA_Future<T>(_state); }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  set : set the result, then either call the future's then() function or wake get()
+  //
+  //    value : the result
+  //
+  void set(T value) const
+  {
+    std::function<void(T)> then;
+    {
+      std::lock_guard<std::mutex> lk(_state->mtx);
+      _state->value = std::move(value);
+      _state->done = true;
+      then.swap(_state->then);
+    }
+    if (then) { then(std::move(*_state->value)); }
+    else      { _state->cv.notify_all(); }
+  }
+
+private:
+  std::shared_ptr<typename RA_Future<T>::state> _state;
+};
+
+#ifdef REDIS_ADAPTER_COROUTINES
+//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+//  class RA_Batches
+//
+//  An async generator of batches (e.g. what a stream reader delivers per read) - the
+//  producer pushes batches from any thread and one consumer coroutine takes them with
+//
+//    while (auto batch = co_await batches.next()) { ... *batch ... }
+//
+//  next() yields an empty optional once the batches are closed and drained - batches
+//  pushed while the consumer is not waiting are queued, and a waiting consumer is
+//  resumed on the pushing thread (for RedisAdapter readers, a worker pool thread)
+//
+template<typename T> class RA_Batches
+{
+  struct state
+  {
+    std::mutex mtx;
+    std::deque<T> queue;
+    std::coroutine_handle<> waiter;
+    bool closed = false;
+  };
+
+public:
+  RA_Batches() : _state(std::make_shared<state>()) {}
+
+  RA_Batches(RA_Batches&&) = default;
+  RA_Batches& operator=(RA_Batches&&) = default;
+
+  ~RA_Batches() { if (_state) close(); }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  next : awaitable for the next batch, an empty optional when closed and drained
+  //
+  auto next()
+  {
+    struct awaiter
+    {
+      std::shared_ptr<state> st;
+
+      bool await_ready() const
+      {
+        std::lock_guard<std::mutex> lk(st->mtx);
+        return st->queue.size() || st->closed;
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle)
+      {
+        std::lock_guard<std::mutex> lk(st->mtx);
+        if (st->queue.size() || st->closed) return false;
+        st->waiter = handle;
+        return true;
+      }
+
+      std::optional<T> await_resume()
+      {
+        std::lock_guard<std::mutex> lk(st->mtx);
+        if (st->queue.empty()) return {};
+        std::optional<T> ret(std::move(st->queue.front()));
+        st->queue.pop_front();
+        return ret;
+      }
+    };
+    return awaiter{ _state };
+  }
+
+  //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+  //  pusher : a function that pushes a batch, safe to keep after this object is gone
+  //           (batches pushed after close are dropped)
+  //  close  : no more batches, wake the consumer so next() can finish
+  //
+  std::function<void(T)> pusher() const
+  {
+    return [st = _state](T batch) { resume(st, [&]() { if ( ! st->closed) st->queue.push_back(std::move(batch)); }); };
+  }
+
+  void close() { resume(_state, [this]() { _state->closed = true; }); }
+
+private:
+  std::shared_ptr<state> _state;
+
+  //  apply a change under the lock, then resume the consumer if it was waiting
+  template<typename Fn> static void resume(const std::shared_ptr<state>& st, Fn change)
+  {
+    std::coroutine_handle<> waiter;
+    {
+      std::lock_guard<std::mutex> lk(st->mtx);
+      change();
+      if (st->queue.size() || st->closed) std::swap(waiter, st->waiter);
+    }
+    if (waiter) waiter.resume();
+  }
+};
+#endif
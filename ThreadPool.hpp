@@ -27,27 +27,71 @@ public:
 
   void job(const std::string& name, std::function<void(void)> func)
   {
-    static std::hash<std::string> hasher;
+    Worker* w = worker(name);
+    if ( ! w) return;
 
-    int idx = 0;
-    size_t num = _workers.size();
+    std::unique_lock<std::mutex> lk(w->_mtx);
+    w->_jobs.emplace(std::move(func));
+    lk.unlock();
 
-    switch (num)
-    {
-      //  no workers
-      case 0: return;
-      //  one worker - no need to hash
-      case 1: break;
-      //  assign job to thread deterministically by name hash
-      default: idx = hasher(name) % num; break;
-    }
-    Worker& w = _workers[idx];
+    w->_cv.notify_all();
+  }
+
+  //  wait until every job queued for a name before this call has run - returns at once
+  //  when called from one of the pool's own workers, which could be waiting on itself
+  void drain(const std::string& name)
+  {
+    Worker* w = worker(name);
+    if ( ! w || on_worker()) return;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool done = false;
 
-    std::unique_lock<std::mutex> lk(w._mtx);
-    w._jobs.emplace(std::move(func));
+    std::unique_lock<std::mutex> lk(w->_mtx);
+    w->_jobs.emplace([&]()
+      {
+        std::lock_guard<std::mutex> done_lk(mtx);
+        done = true;
+        cv.notify_all();
+      });
     lk.unlock();
 
-    w._cv.notify_all();
+    w->_cv.notify_all();
+
+    std::unique_lock<std::mutex> done_lk(mtx);
+    cv.wait(done_lk, [&]() { return done; });
+  }
+
+  //  true if called from one of the pool's workers
+  bool on_worker() const
+  {
+    for (const auto& w : _workers)
+      { if (w._thd.get_id() == std::this_thread::get_id()) return true; }
+    return false;
+  }
+
+  //  wait until every job queued before this call has run
+  void drain()
+  {
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t left = _workers.size();
+
+    for (auto& w : _workers)
+    {
+      std::unique_lock<std::mutex> lk(w._mtx);
+      w._jobs.emplace([&]()
+        {
+          std::lock_guard<std::mutex> done_lk(mtx);
+          if (--left == 0) cv.notify_all();
+        });
+      lk.unlock();
+
+      w._cv.notify_all();
+    }
+    std::unique_lock<std::mutex> lk(mtx);
+    cv.wait(lk, [&]() { return left == 0; });
   }
 
 private:
@@ -82,5 +126,21 @@ private:
     }
   };
 
+  //  the worker a name's jobs run on, nullptr if there are no workers
+  Worker* worker(const std::string& name)
+  {
+    static std::hash<std::string> hasher;
+
+    switch (_workers.size())
+    {
+      //  no workers
+      case 0: return nullptr;
+      //  one worker - no need to hash
+      case 1: return &_workers[0];
+      //  assign job to thread deterministically by name hash
+      default: return &_workers[hasher(name) % _workers.size()];
+    }
+  }
+
   std::vector<Worker> _workers;
 };
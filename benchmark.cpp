@@ -1,6 +1,7 @@
 #include <benchmark/benchmark.h>
 #include "RedisAdapter.hpp"
 #include "RedisCache.hpp"
+#include "RedisCacheManager.hpp"
 #include <cstdlib>
 #include <vector>
 
@@ -43,6 +44,72 @@ static void Benchmark_Baseline(benchmark::State& state)
     for (auto _ : state) { benchmark::DoNotOptimize(_); }
 }
 
+// RA_Time ID formatting and parsing as they were, with to_string/stoll, for comparison
+static std::string legacy_id(int64_t value)
+{
+    return std::to_string(value / 1'000'000) + "-" + std::to_string(value % 1'000'000);
+}
+
+static int64_t legacy_parse(const std::string& id)
+{
+    try
+    {
+        int64_t value = std::stoll(id) * 1'000'000;
+        size_t pos = id.find('-');
+        if (pos != std::string::npos) { value += std::stoll(id.substr(pos + 1)); }
+        return value;
+    }
+    catch (...) { return 0; }
+}
+
+// RA_Time per-entry ID cost, before (Legacy) and after
+static void Benchmark_TimeFormat_Legacy(benchmark::State& state)
+{
+    int64_t value = 1760000000'123456789;
+    for (auto _ : state) { benchmark::DoNotOptimize(legacy_id(value++)); }
+}
+
+static void Benchmark_TimeFormat_Id(benchmark::State& state)
+{
+    RA_Time time(1760000000'123456789);
+    for (auto _ : state) { benchmark::DoNotOptimize(time.id()); time.value++; }
+}
+
+static void Benchmark_TimeFormat_Chars(benchmark::State& state)
+{
+    RA_Time time(1760000000'123456789);
+    for (auto _ : state) { benchmark::DoNotOptimize(time.chars()); time.value++; }
+}
+
+static void Benchmark_TimeParse_Legacy(benchmark::State& state)
+{
+    std::string id = RA_Time(1760000000'123456789).id();
+    for (auto _ : state) { benchmark::DoNotOptimize(legacy_parse(id)); }
+}
+
+static void Benchmark_TimeParse(benchmark::State& state)
+{
+    std::string id = RA_Time(1760000000'123456789).id();
+    for (auto _ : state) { benchmark::DoNotOptimize(RA_Time(id)); }
+}
+
+// Decoding a 10k-entry range of one-field entries, with the fields in an unordered_map
+// (as before) and in RA_Fields, then reading each value back
+template<typename F> static void decode_range(benchmark::State& state)
+{
+    std::string value(sizeof(float), 'x');
+    for (auto _ : state)
+    {
+        std::vector<std::pair<std::string, F>> raw;
+        for (int64_t i = 0; i < 10000; i++) { raw.emplace_back(RA_Time(1760000000'000000000 + i).id(), F{{ "_", value }}); }
+        for (const auto& item : raw) { benchmark::DoNotOptimize(item.second.find("_")->second.data()); }
+    }
+}
+
+static void Benchmark_Decode_Map(benchmark::State& state) { decode_range<RA_Fields::Attrs>(state); }
+
+static void Benchmark_Decode_Fields(benchmark::State& state) { decode_range<RA_Fields>(state); }
+
 // Single value add benchmark
 static void Benchmark_AddSingleValue(benchmark::State& state)
 {
@@ -79,6 +146,128 @@ static void Benchmark_GetList(benchmark::State& state)
     for (auto _ : state) { std::vector<float> result; redis.getSingleList("benchmark_list_key", result);}
 }
 
+// Range of 100 short lists, into a new result, into a reused result, and into an arena
+// released per call
+static void fill_lists100(RedisAdapter& redis)
+{
+    RedisAdapter::TimeValList<std::vector<float>> data(100, { 0, generate_list(16) });
+    redis.addLists("benchmark_lists_key", data, 100);
+}
+
+static void Benchmark_GetLists100(benchmark::State& state)
+{
+    RedisAdapter redis("TEST", get_redis_options());
+    fill_lists100(redis);
+
+    for (auto _ : state) { benchmark::DoNotOptimize(redis.getListsBefore<float>("benchmark_lists_key", { .count = 100 })); }
+}
+
+static void Benchmark_GetLists100_Reuse(benchmark::State& state)
+{
+    RedisAdapter redis("TEST", get_redis_options());
+    fill_lists100(redis);
+
+    RedisAdapter::TimeValList<std::vector<float>> result;
+    for (auto _ : state) { redis.getListsBefore<float>("benchmark_lists_key", result, { .count = 100 }); }
+}
+
+static void Benchmark_GetLists100_Pmr(benchmark::State& state)
+{
+    RedisAdapter redis("TEST", get_redis_options());
+    fill_lists100(redis);
+
+    std::vector<std::byte> buffer(64 * 1024);
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(redis.getListsBefore<float>("benchmark_lists_key", arena, { .count = 100 }));
+        arena.release();
+    }
+}
+
+// Connection snapshot benchmark, keyslot() is computed locally so this is the per call
+// overhead every RedisConnection method pays before talking to redis, run from many
+// threads at once against one connection to show it does not contend
+static void Benchmark_Snapshot(benchmark::State& state)
+{
+    static RedisConnection conn(get_redis_options().cxn);
+    for (auto _ : state) { benchmark::DoNotOptimize(conn.keyslot("benchmark_key")); }
+}
+
+// Single value get benchmark with many threads sharing one adapter
+static void Benchmark_GetSingleValue_Threads(benchmark::State& state)
+{
+    static RedisAdapter redis("TEST", get_redis_options());
+    if (state.thread_index() == 0) { redis.addSingleValue("benchmark_key", "benchmark_value"); }
+    for (auto _ : state) { std::string value; redis.getSingleValue("benchmark_key", value);}
+}
+
+// One front-end cycle of 50 adds and 20 gets, synchronous (70 round trips)
+static void Benchmark_Cycle(benchmark::State& state)
+{
+    RedisAdapter redis("TEST", get_redis_options());
+    for (auto _ : state)
+    {
+        for (int i = 0; i < 50; i++) { redis.addSingleValue("cycle" + std::to_string(i), i); }
+        for (int i = 0; i < 20; i++) { int value; redis.getSingleValue("cycle" + std::to_string(i), value); }
+    }
+}
+
+// The same cycle with the async methods, all in flight at once
+static void Benchmark_CycleAsync(benchmark::State& state)
+{
+    RedisAdapter redis("TEST", get_redis_options());
+    std::vector<RA_Future<RA_Time>> adds;
+    std::vector<RA_Future<RedisAdapter::TimeVal<int>>> gets;
+    for (auto _ : state)
+    {
+        for (int i = 0; i < 50; i++) { adds.push_back(redis.addSingleValueAsync("cycle" + std::to_string(i), i)); }
+        for (int i = 0; i < 20; i++) { gets.push_back(redis.getSingleValueAsync<int>("cycle" + std::to_string(i))); }
+        for (auto& add : adds) { add.wait(); }
+        for (auto& get : gets) { get.wait(); }
+        adds.clear();
+        gets.clear();
+    }
+}
+
+// Adapter construction, after the first one has found the server type
+static void Benchmark_Construct(benchmark::State& state)
+{
+    RedisAdapter first("TEST", get_redis_options());
+    for (auto _ : state) { RedisAdapter redis("TEST", get_redis_options()); }
+}
+
+// Adapter construction on a shared hub - no connections or threads of its own to make
+static void Benchmark_ConstructOnHub(benchmark::State& state)
+{
+    auto hub = std::make_shared<RedisHub>(get_redis_options());
+    for (auto _ : state) { RedisAdapter redis("TEST", hub); }
+}
+
+// Latest value of 500 devices, one at a time and all in flight at once - on a cluster the
+// async snapshot runs one pipeline per node concurrently, so it approaches the round trip of
+// the slowest node (the streams need not exist, it is the round trips being measured)
+static void Benchmark_Snapshot500(benchmark::State& state)
+{
+    RedisAdapter redis("TEST", get_redis_options());
+    for (auto _ : state)
+    {
+        for (int i = 0; i < 500; i++) { int value; redis.getSingleValue("status", value, { .baseKey = "DEV" + std::to_string(i) }); }
+    }
+}
+
+static void Benchmark_Snapshot500Async(benchmark::State& state)
+{
+    RedisAdapter redis("TEST", get_redis_options());
+    std::vector<RA_Future<RedisAdapter::TimeVal<int>>> gets;
+    for (auto _ : state)
+    {
+        for (int i = 0; i < 500; i++) { gets.push_back(redis.getSingleValueAsync<int>("status", { .baseKey = "DEV" + std::to_string(i) })); }
+        for (auto& get : gets) { get.wait(); }
+        gets.clear();
+    }
+}
+
 static void Benchmark_copyReadBuffer_Full(benchmark::State& state)
 {
     auto redis = std::make_shared<RedisAdapter>("TEST", get_redis_options());
@@ -94,6 +283,36 @@ static void Benchmark_copyReadBuffer_Full(benchmark::State& state)
     for (auto _ : state) { std::vector<float> result; cache.copyReadBuffer(result);}
 }
 
+static void Benchmark_snapshot_Full(benchmark::State& state)
+{
+    auto redis = std::make_shared<RedisAdapter>("TEST", get_redis_options());
+    size_t size = state.range(0);
+    std::vector<float> values = generate_list(size);
+    redis->addSingleList("benchmark_list_key", values, {.trim = 100});
+    std::string key = "benchmark_list_key";
+    RedisCache<float> cache(redis, key);
+
+    cache.snapshot();
+
+    for (auto _ : state) { auto frame = cache.snapshot(); benchmark::DoNotOptimize(frame->data.data()); }
+}
+
+// Frame at or before a time in a history of depth frames, loaded with one XREVRANGE
+static void Benchmark_copyAt(benchmark::State& state)
+{
+    auto redis = std::make_shared<RedisAdapter>("TEST", get_redis_options());
+    size_t depth = state.range(0);
+    std::vector<float> values = generate_list(1024);
+    std::string key = "benchmark_history_key";
+    for (size_t i = 0; i < depth; i++) { redis->addSingleList(key, values, {.trim = (uint32_t)depth}); }
+    RedisCache<float> cache(redis, key, depth);
+
+    auto frames = cache.frames();
+    RA_Time middle = (*frames)[frames->size() / 2]->time;
+
+    for (auto _ : state) { std::vector<float> result; cache.copyAt(middle, result); }
+}
+
 static void Benchmark_copyReadBuffer_SingleValue(benchmark::State& state)
 {
     auto redis = std::make_shared<RedisAdapter>("TEST", get_redis_options());
@@ -128,12 +347,174 @@ static void Benchmark_copyReadBuffer_FiftyValues(benchmark::State& state)
     for (auto _ : state) { cache.copyReadBuffer(resultSpan, arbitraryStartIndex);}
 }
 
+// Cache reads from many threads while the stream keeps writing the cache, the writes
+// counter shows the writer is not held off by the readers
+static void Benchmark_copyReadBuffer_Contended(benchmark::State& state)
+{
+    static std::shared_ptr<RedisAdapter> redis;
+    static std::unique_ptr<RedisCache<float>> cache;
+    static std::atomic<bool> writing;
+    static std::thread writer;
+    static uint64_t firstWrite;
+    std::string key = "benchmark_contended_key";
+
+    if (state.thread_index() == 0)
+    {
+        redis = std::make_shared<RedisAdapter>("TEST", get_redis_options());
+        redis->addSingleList(key, generate_list(1024), {.trim = 100});
+        cache = std::make_unique<RedisCache<float>>(redis, key);
+        std::vector<float> tempInitilizaer;
+        cache->copyReadBuffer(tempInitilizaer);
+
+        writing = true;
+        writer = std::thread([key]()
+            {
+                std::vector<float> values = generate_list(1024);
+                while (writing) { redis->addSingleList(key, values, {.trim = 100}); }
+            });
+        firstWrite = cache->sequence();
+    }
+
+    std::vector<float> result;
+    for (auto _ : state) { cache->copyReadBuffer(result); }
+
+    if (state.thread_index() == 0)
+    {
+        state.counters["writes"] = cache->sequence() - firstWrite;
+        writing = false;
+        writer.join();
+        redis->removeReader(key);
+        cache.reset();
+        redis.reset();
+    }
+}
+
+// Latency from an add to a waiting cache reader seeing it, polling every 1 ms and blocking
+static void cache_wait(benchmark::State& state, bool poll)
+{
+    auto redis = std::make_shared<RedisAdapter>("TEST", get_redis_options());
+    std::vector<float> values = generate_list(16);
+    std::string key = "benchmark_wait_key";
+    RedisCache<float> cache(redis, key);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));   // let the reader start
+
+    for (auto _ : state)
+    {
+        redis->addSingleList(key, values, {.trim = 100});
+        if (poll) { cache.waitForNewValue(std::chrono::milliseconds(1)); }
+        else      { cache.waitForNewValue(); }
+    }
+}
+
+static void Benchmark_CacheWait_Poll(benchmark::State& state) { cache_wait(state, true); }
+
+static void Benchmark_CacheWait(benchmark::State& state) { cache_wait(state, false); }
+
+// Reads of 1000 keys skewed toward the first ones, with a budget for the percentage of them in the argument
+static void Benchmark_CacheManager(benchmark::State& state)
+{
+    auto redis = std::make_shared<RedisAdapter>("TEST", get_redis_options());
+    std::vector<float> values = generate_list(256);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; i++)
+    {
+        keys.push_back("benchmark_manager_key_" + std::to_string(i));
+        redis->addSingleList(keys.back(), values, {.trim = 1});
+    }
+    size_t budget = keys.size() * state.range(0) / 100 * (values.size() * sizeof(float) + 256);
+    RedisCacheManager<float> manager(redis, budget);
+    manager.watch(keys);
+
+    uint32_t seed = 1;
+    for (auto _ : state)
+    {
+        seed = seed * 1664525 + 1013904223;
+        size_t idx = (seed >> 8) % keys.size();
+        idx = idx * idx / keys.size();   //  favor low indexes
+        benchmark::DoNotOptimize(manager.snapshot(keys[idx])->data.data());
+    }
+    auto stats = manager.stats();
+    state.counters["hits"] = stats.hits;
+    state.counters["misses"] = stats.misses;
+    state.counters["evictions"] = stats.evictions;
+}
+
+// Cached scalar setting read in a loop, lock free, from 1 to 16 threads
+static void Benchmark_ValueCache_Scalar(benchmark::State& state)
+{
+    static std::shared_ptr<RedisAdapter> redis;
+    static std::unique_ptr<RedisValueCache<double>> cache;
+    std::string key = "benchmark_scalar_key";
+
+    if (state.thread_index() == 0)
+    {
+        redis = std::make_shared<RedisAdapter>("TEST", get_redis_options());
+        redis->addSingleDouble(key, 1.5, {.trim = 100});
+        cache = std::make_unique<RedisValueCache<double>>(redis, key);
+    }
+
+    double value = 0;
+    for (auto _ : state) { cache->copyReadValue(value); benchmark::DoNotOptimize(value); }
+
+    if (state.thread_index() == 0)
+    {
+        cache.reset();
+        redis.reset();
+    }
+}
+
+// Cached string setting read in a loop
+static void Benchmark_ValueCache_String(benchmark::State& state)
+{
+    auto redis = std::make_shared<RedisAdapter>("TEST", get_redis_options());
+    std::string key = "benchmark_string_key";
+    redis->addSingleValue(key, std::string("a setting of some length"), {.trim = 100});
+    RedisValueCache<std::string> cache(redis, key);
+
+    std::string value;
+    for (auto _ : state) { cache.copyReadValue(value); benchmark::DoNotOptimize(value.data()); }
+}
+
 // Baseline
 BENCHMARK(Benchmark_Baseline);
+
+BENCHMARK(Benchmark_TimeFormat_Legacy);
+BENCHMARK(Benchmark_TimeFormat_Id);
+BENCHMARK(Benchmark_TimeFormat_Chars);
+BENCHMARK(Benchmark_TimeParse_Legacy);
+BENCHMARK(Benchmark_TimeParse);
+BENCHMARK(Benchmark_Decode_Map);
+BENCHMARK(Benchmark_Decode_Fields);
 //Add Single Value
 BENCHMARK(Benchmark_AddSingleValue);
 //Get Single Value
 BENCHMARK(Benchmark_GetSingleValue);
+//Front-end cycle of 50 adds and 20 gets, sync and async
+BENCHMARK(Benchmark_Cycle);
+BENCHMARK(Benchmark_CycleAsync);
+//Adapter construction
+BENCHMARK(Benchmark_Construct);
+BENCHMARK(Benchmark_ConstructOnHub);
+//Latest value of 500 devices, sync and async
+BENCHMARK(Benchmark_Snapshot500);
+BENCHMARK(Benchmark_Snapshot500Async);
+//Cached reads from 1 to 16 threads while the cache is written
+BENCHMARK(Benchmark_copyReadBuffer_Contended)->ThreadRange(1, 16)->UseRealTime();
+//Cache of 1000 keys with budgets for 10%, 50% and 100% of them
+BENCHMARK(Benchmark_CacheManager)->Arg(10)->Arg(50)->Arg(100);
+//Cached single values, a scalar from 1 to 16 threads and a string
+BENCHMARK(Benchmark_ValueCache_Scalar)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(Benchmark_ValueCache_String);
+//Cache wakeup, polling and blocking
+BENCHMARK(Benchmark_CacheWait_Poll)->UseRealTime();
+BENCHMARK(Benchmark_CacheWait)->UseRealTime();
+//Range of 100 lists, new result, reused result and arena
+BENCHMARK(Benchmark_GetLists100);
+BENCHMARK(Benchmark_GetLists100_Reuse);
+BENCHMARK(Benchmark_GetLists100_Pmr);
+//Connection snapshot and Get Single Value from 1 to 16 threads
+BENCHMARK(Benchmark_Snapshot)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(Benchmark_GetSingleValue_Threads)->ThreadRange(1, 16)->UseRealTime();
 
 //Add List of different sizes
 BENCHMARK(Benchmark_AddList)->Arg(256)->Arg(512)->Arg(1024)->Arg(1536)->Arg(2048)->Arg(3072)->Arg(4096)
@@ -152,6 +533,12 @@ BENCHMARK(Benchmark_copyReadBuffer_Full)->Arg(256)->Arg(512)->Arg(1024)->Arg(153
                             ->Arg(65536)->Arg(131072)->Arg(262144)->Arg(524288)->Arg(1048576)->Arg(2097152)
                             ->Arg(4194304)->Arg(8388608);  // These are vector sizes, total size in bytes will be 4x
 
+//Share List of different sizes Cached, no copy
+BENCHMARK(Benchmark_snapshot_Full)->Arg(256)->Arg(4096)->Arg(65536)->Arg(1048576)->Arg(8388608);
+
+//Get List of 1024 at a time from history of different depths Cached
+BENCHMARK(Benchmark_copyAt)->Arg(1)->Arg(16)->Arg(256)->Arg(4096);
+
 //Get one element of List of different sizes Cached
 BENCHMARK(Benchmark_copyReadBuffer_SingleValue)->Arg(256)->Arg(512)->Arg(1024)->Arg(1536)->Arg(2048)->Arg(3072)->Arg(4096)
                             ->Arg(6144)->Arg(8192)->Arg(12288)->Arg(16384)->Arg(24576)->Arg(32768)->Arg(49152)
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include "RedisAdapter.hpp"
+#include "RedisCache.hpp"
+#include "RedisCacheManager.hpp"
 
 using namespace std;
 using namespace sw::redis;
@@ -36,6 +38,63 @@ TEST(RedisAdapter, UnixDomainSocket)
     EXPECT_TRUE(redis->connected()) << "Failed to connect to the Redis server using Unix domain socket.";
 }
 
+TEST(RA_Time, Codec)
+{
+  EXPECT_EQ(RA_Time("12345-67089").value, 12345'067089);
+  EXPECT_EQ(RA_Time(string("12345")).value, 12345'000000);
+  EXPECT_EQ(RA_Time(string_view("12345-67089xyz", 11)).value, 12345'067089);
+  EXPECT_EQ(RA_Time("-").value, 0);
+  EXPECT_EQ(RA_Time("+").value, 0);
+  EXPECT_EQ(RA_Time("12345-x").value, 0);
+
+  //  char pointers and buffers parse up to the terminator, a literal 0 is still nanoseconds
+  const char* ptr = "12345-67089";
+  char buf[32] = "12345";
+  EXPECT_EQ(RA_Time(ptr).value, 12345'067089);
+  EXPECT_EQ(RA_Time(buf).value, 12345'000000);
+  EXPECT_EQ(RA_Time(0).value, 0);
+
+  RA_Time big(INT64_MAX);
+  auto chars = big.chars();
+  EXPECT_EQ(string_view(chars), "9223372036854-775807");
+  EXPECT_EQ(RA_Time(string_view(chars)).value, INT64_MAX);
+  EXPECT_EQ(RA_Time(1'000'000).id(), "1-0");
+  EXPECT_EQ(RA_Time().id(), "0-0");
+  EXPECT_EQ(RA_Time(RA_Time(1760000000'123456789).id()).value, 1760000000'123456789);
+}
+
+TEST(RA_Fields, Container)
+{
+  //  one field stays inline, more move to the heap in order
+  RA_Fields fields = {{ "_", "xxx" }};
+  EXPECT_EQ(fields.size(), 1);
+  EXPECT_EQ(fields.find("_")->second, "xxx");
+  EXPECT_EQ(fields.find("a"), fields.end());
+
+  fields.emplace_back("a", "1");
+  fields.push_back(fields[0]);
+  ASSERT_EQ(fields.size(), 3);
+  EXPECT_EQ(fields[0].second, "xxx");
+  EXPECT_EQ(fields[1].first, "a");
+  EXPECT_EQ(fields[2].second, "xxx");
+  EXPECT_EQ(fields.count("_"), 2);
+
+  //  converts to and from the public Attrs
+  RA_Fields::Attrs attrs = fields;
+  EXPECT_EQ(attrs.size(), 2);
+  EXPECT_EQ(attrs.at("a"), "1");
+  RA_Fields back = attrs;
+  EXPECT_EQ(back.size(), 2);
+  EXPECT_EQ(back.find("a")->second, "1");
+
+  RA_Fields moved = std::move(fields);
+  EXPECT_EQ(moved.size(), 3);
+  moved.clear();
+  EXPECT_TRUE(moved.empty());
+  moved.emplace_back("b", "2");
+  EXPECT_EQ(moved.begin()->second, "2");
+}
+
 TEST(RedisAdapter, DataSingle)
 {
   RedisAdapter redis("TEST");
@@ -85,6 +144,180 @@ TEST(RedisAdapter, DataSingle)
   EXPECT_EQ(vi[2], 3);
 }
 
+TEST(RedisAdapter, DataAsync)
+{
+  RedisAdapter redis("TEST");
+
+  //  many operations in flight at once, then wait for each of them
+  vector<RA_Future<RA_Time>> adds;
+  for (int i = 0; i < 50; i++) { adds.push_back(redis.addSingleValueAsync("async" + to_string(i), i)); }
+  adds.push_back(redis.addSingleListAsync("async", vector<float>{ 1.23, 3.45, 5.67 }));
+  adds.push_back(redis.addSingleDoubleAsync("asyncd", 1.23));
+  adds.push_back(redis.addSingleValueAsync<string>("asyncs", "xxx"));
+  for (auto& add : adds) { EXPECT_TRUE(add.get().ok()); }
+
+  vector<RA_Future<RA::TimeVal<int>>> gets;
+  for (int i = 0; i < 50; i++) { gets.push_back(redis.getSingleValueAsync<int>("async" + to_string(i))); }
+  for (int i = 0; i < 50; i++)
+  {
+    auto tv = gets[i].get();
+    EXPECT_TRUE(tv.first.ok());
+    EXPECT_EQ(tv.second, i);
+  }
+
+  auto vf = redis.getSingleListAsync<float>("async").get();
+  EXPECT_TRUE(vf.first.ok());
+  EXPECT_EQ(vf.second.size(), 3);
+  EXPECT_FLOAT_EQ(vf.second[1], 3.45);
+
+  EXPECT_DOUBLE_EQ(redis.getSingleValueAsync<double>("asyncd").get().second, 1.23);
+  EXPECT_STREQ(redis.getSingleValueAsync<string>("asyncs").get().second.c_str(), "xxx");
+
+  //  batch add with history, then completion by callback
+  RA::TimeValList<int> data = { { 0, 1 }, { 0, 2 }, { 0, 3 } };
+  auto ids = redis.addValuesAsync("asyncm", data, 3).get();
+  EXPECT_EQ(ids.size(), 3);
+
+  atomic<bool> waiting = true;
+  redis.getValuesAsync<int>("asyncm").then([&](RA::TimeValList<int> vals)
+    {
+      EXPECT_EQ(vals.size(), 3);
+      if (vals.size() == 3) { EXPECT_EQ(vals[2].second, 3); }
+      waiting = false;
+    }
+  );
+  for (int i = 0; i < 20 && waiting; i++)
+    this_thread::sleep_for(milliseconds(5));
+
+  //  should not be waiting anymore
+  EXPECT_FALSE(waiting);
+
+  auto before = redis.getValuesBeforeAsync<int>("asyncm", { .count = 2 }).get();
+  EXPECT_EQ(before.size(), 2);
+  if (before.size() == 2) { EXPECT_EQ(before[1].second, 3); }
+}
+
+TEST(RedisAdapter, DataFanout)
+{
+  //  a few devices, which on a cluster land on different nodes
+  vector<unique_ptr<RedisAdapter>> devs;
+  for (int i = 0; i < 8; i++)
+  {
+    devs.push_back(make_unique<RedisAdapter>("FANOUT" + to_string(i)));
+    EXPECT_TRUE(devs.back()->addSingleValue("status", i).ok());
+  }
+
+  //  the latest value of every device at once, then delete them all at once
+  RedisAdapter redis("TEST");
+  vector<RA_Future<RA::TimeVal<int>>> gets;
+  for (int i = 0; i < 8; i++) { gets.push_back(redis.getSingleValueAsync<int>("status", { .baseKey = "FANOUT" + to_string(i) })); }
+  for (int i = 0; i < 8; i++)
+  {
+    auto tv = gets[i].get();
+    EXPECT_TRUE(tv.first.ok());
+    EXPECT_EQ(tv.second, i);
+  }
+
+  vector<RA_Future<bool>> dels;
+  for (auto& dev : devs) { dels.push_back(dev->delAsync("status")); }
+  for (auto& del : dels) { EXPECT_TRUE(del.get()); }
+
+  for (int i = 0; i < 8; i++)
+  {
+    int value;
+    EXPECT_FALSE(redis.getSingleValue("status", value, { .baseKey = "FANOUT" + to_string(i) }).ok());
+  }
+}
+
+TEST(RedisAdapter, ReplicaReads)
+{
+  //  on a single server (or a cluster without replicas) reads just go to the master
+  RA_Options opts;
+  opts.cxn.readFrom = RedisConnection::ReadFrom::PREFER_REPLICA;
+  opts.cxn.staleness = 1000;
+  RedisAdapter redis("TEST", opts);
+
+  EXPECT_TRUE(redis.addSingleValue("replica", 123).ok());
+
+  //  replication is asynchronous, so a replica may take a moment to see the add
+  int value = 0;
+  for (int i = 0; i < 20 && value != 123; i++)
+  {
+    redis.getSingleValue("replica", value);
+    if (value != 123) this_thread::sleep_for(milliseconds(5));
+  }
+  EXPECT_EQ(value, 123);
+
+  auto tv = redis.getSingleValueAsync<int>("replica").get();
+  EXPECT_TRUE(tv.first.ok());
+  EXPECT_EQ(tv.second, 123);
+}
+
+#ifdef REDIS_ADAPTER_COROUTINES
+//  minimal eagerly started coroutine - coroutines here are free functions taking
+//  references, a capturing lambda's closure would be gone by the time it resumes
+struct co_test
+{
+  struct promise_type
+  {
+    co_test get_return_object() { return {}; }
+    suspend_never initial_suspend() { return {}; }
+    suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { terminate(); }
+  };
+};
+
+co_test co_single(RedisAdapter& redis, const vector<float>& vf, atomic<bool>& waiting)
+{
+  EXPECT_TRUE((co_await redis.addSingleListAsync("coro", vf)).ok());
+  auto [time, list] = co_await redis.getSingleListAsync<float>("coro");
+  EXPECT_TRUE(time.ok());
+  EXPECT_EQ(list.size(), vf.size());
+  waiting = false;
+}
+
+co_test co_batches(RA_Batches<RA::TimeValList<int>>& batches, atomic<int>& sum)
+{
+  while (auto batch = co_await batches.next())
+  {
+    for (const auto& tv : *batch) { sum += tv.second; }
+  }
+}
+
+TEST(RedisAdapter, DataCoroutine)
+{
+  RedisAdapter redis("TEST");
+  atomic<bool> waiting = true;
+  vector<float> vf = { 1.23, 3.45 };
+
+  co_single(redis, vf, waiting);
+
+  for (int i = 0; i < 20 && waiting; i++)
+    this_thread::sleep_for(milliseconds(5));
+
+  //  should not be waiting anymore
+  EXPECT_FALSE(waiting);
+
+  //  reader batches as an async generator
+  auto batches = redis.addValuesReaderAsync<int>("corord");
+  atomic<int> sum = 0;
+
+  co_batches(batches, sum);
+
+  this_thread::sleep_for(milliseconds(5));
+  EXPECT_TRUE(redis.addSingleValue("corord", 3).ok());
+  EXPECT_TRUE(redis.addSingleValue("corord", 4).ok());
+
+  for (int i = 0; i < 20 && sum < 7; i++)
+    this_thread::sleep_for(milliseconds(5));
+
+  EXPECT_EQ(sum, 7);
+  EXPECT_TRUE(redis.removeReader("corord"));
+  batches.close();
+}
+#endif
+
 TEST(RedisAdapter, ExactTrim)
 {
   RedisAdapter redis("TEST");
@@ -103,6 +336,35 @@ TEST(RedisAdapter, ExactTrim)
   EXPECT_EQ(values[2].second, 9);
 }
 
+TEST(RedisAdapter, MonotonicIDs)
+{
+  RedisAdapter redis("TEST");
+  ASSERT_TRUE(redis.del("monotonic"));
+  auto adjusted = redis.adjustedIDs();
+
+  RA_Time time = redis.addSingleValue("monotonic", 0, { .trim = 0 });
+  ASSERT_TRUE(time.ok());
+
+  //  the same time again, or one just before it, goes 1 ns after the last
+  EXPECT_EQ(redis.addSingleValue("monotonic", 1, { .time = time, .trim = 0 }).value, time.value + 1);
+  EXPECT_EQ(redis.addSingleValue("monotonic", 2, { .time = time.value - 1000, .trim = 0 }).value, time.value + 2);
+  EXPECT_EQ(redis.adjustedIDs() - adjusted, 2);
+
+  //  a time well before it is kept, and refused
+  EXPECT_FALSE(redis.addSingleValue("monotonic", -1, { .time = time.value - 3600000000000, .trim = 0 }).ok());
+  EXPECT_EQ(redis.adjustedIDs() - adjusted, 2);
+
+  //  so a burst of adds and a batch with duplicate times all land, in order
+  for (int i = 3; i < 1003; i++) { EXPECT_TRUE(redis.addSingleValue("monotonic", i, { .trim = 0 }).ok()); }
+  auto ids = redis.addValues<int>("monotonic", {{ time, 1003 }, { time, 1004 }}, 0);
+  ASSERT_EQ(ids.size(), 2);
+  EXPECT_LT(ids[0].value, ids[1].value);
+
+  auto values = redis.getValues<int>("monotonic");
+  ASSERT_EQ(values.size(), 1005);
+  for (int i = 0; i < 1005; i++) { EXPECT_EQ(values[i].second, i); }
+}
+
 TEST(RedisAdapter, Data)
 {
   RedisAdapter redis("TEST");
@@ -208,6 +470,118 @@ TEST(RedisAdapter, DataList)
   EXPECT_FLOAT_EQ(is_vf.at(1).second[2], 2.3);
 }
 
+TEST(RedisAdapter, DataPmr)
+{
+  RedisAdapter redis("TEST");
+
+  RA::TimeValList<vector<float>> is_vf = {{ 0, { 1.1, 1.2, 1.3 }}, { 0, { 2.1, 2.2, 2.3 }}};
+  auto ids = redis.addLists("abc", is_vf);
+  ASSERT_EQ(ids.size(), 2);
+  RA::TimeValList<int> is_i = {{ 0, 1 }, { 0, 2 }, { 0, 3 }};
+  auto iids = redis.addValues("def", is_i, 3);
+  ASSERT_EQ(iids.size(), 3);
+
+  //  everything comes from the arena, which has no upstream to fall back on
+  vector<byte> buffer(64 * 1024);
+  pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), pmr::null_memory_resource());
+
+  auto pvf = redis.getLists<float>("abc", arena, { .minTime=ids[0], .maxTime=ids[1] });
+  ASSERT_EQ(pvf.size(), 2);
+  EXPECT_EQ(pvf.get_allocator().resource(), &arena);
+  EXPECT_EQ(pvf[1].second.get_allocator().resource(), &arena);
+  EXPECT_EQ(pvf[1].first.value, ids[1].value);
+  ASSERT_EQ(pvf[1].second.size(), 3);
+  EXPECT_FLOAT_EQ(pvf[1].second[2], 2.3);
+
+  auto pi = redis.getValuesBefore<int>("def", arena, { .count = 2 });
+  ASSERT_EQ(pi.size(), 2);
+  EXPECT_EQ(pi[0].second, 2);
+  EXPECT_EQ(pi[1].second, 3);
+
+  pi = redis.getValuesAfter<int>("def", arena, { .minTime = iids[0], .count = 1 });
+  ASSERT_EQ(pi.size(), 1);
+  EXPECT_EQ(pi[0].first.value, iids[0].value);
+
+  //  readers decode each batch into their own arena
+  atomic<int> values = 0, lists = 0;
+  EXPECT_TRUE(redis.addValuesReaderPmr<int>("def", [&](const string&, const string&, const RA::PmrTimeValList<int>& data)
+    {
+      if (data.size() && data[0].second == 4) values++;
+    }
+  ));
+  EXPECT_TRUE(redis.addListsReaderPmr<float>("abc", [&](const string&, const string&, const RA::PmrTimeValList<pmr::vector<float>>& data)
+    {
+      if (data.size() && data[0].second.size() == 3 && data[0].second[0] == 5.0f) lists++;
+    }, "", 256
+  ));
+  this_thread::sleep_for(milliseconds(5));
+
+  for (int i = 0; i < 3; i++)
+  {
+    EXPECT_TRUE(redis.addSingleValue("def", 4).ok());
+    EXPECT_TRUE(redis.addSingleList("abc", vector<float>{ 5, 6, 7 }).ok());
+    for (int j = 0; j < 20 && (values <= i || lists <= i); j++)
+      this_thread::sleep_for(milliseconds(5));
+  }
+  EXPECT_EQ(values, 3);
+  EXPECT_EQ(lists, 3);
+
+  EXPECT_TRUE(redis.removeReader("def"));
+  EXPECT_TRUE(redis.removeReader("abc"));
+}
+
+TEST(RedisAdapter, DataReuse)
+{
+  RedisAdapter redis("TEST");
+
+  RA::TimeValList<vector<float>> is_vf = {{ 0, { 1.1, 1.2, 1.3 }}, { 0, { 2.1, 2.2, 2.3 }}};
+  auto ids = redis.addLists("abc", is_vf);
+  ASSERT_EQ(ids.size(), 2);
+
+  //  a second poll of the same window reuses the lists the first one made
+  RA::TimeValList<vector<float>> vf;
+  EXPECT_TRUE(redis.getListsBefore<float>("abc", vf, { .maxTime = ids[1], .count = 2 }));
+  ASSERT_EQ(vf.size(), 2);
+  const float* data0 = vf[0].second.data();
+  const float* data1 = vf[1].second.data();
+
+  EXPECT_TRUE(redis.getListsBefore<float>("abc", vf, { .maxTime = ids[1], .count = 2 }));
+  ASSERT_EQ(vf.size(), 2);
+  EXPECT_EQ(vf[0].second.data(), data0);
+  EXPECT_EQ(vf[1].second.data(), data1);
+  EXPECT_EQ(vf[0].first.value, ids[0].value);
+  EXPECT_FLOAT_EQ(vf[1].second[2], 2.3);
+
+  //  a smaller window drops the rest
+  EXPECT_TRUE(redis.getListsAfter("abc", vf, { .minTime = ids[1], .count = 5 }));
+  ASSERT_EQ(vf.size(), 1);
+  EXPECT_FLOAT_EQ(vf[0].second[0], 2.1);
+
+  //  values, strings and Attrs
+  RA::TimeValList<int> is_i = {{ 0, 1 }, { 0, 2 }};
+  auto iids = redis.addValues("def", is_i, 2);
+  RA::TimeValList<int> vi = {{ 0, 9 }, { 0, 9 }, { 0, 9 }};
+  EXPECT_TRUE(redis.getValues("def", vi, { .minTime = iids[0], .maxTime = iids[1] }));
+  ASSERT_EQ(vi.size(), 2);
+  EXPECT_EQ(vi[0].second, 1);
+  EXPECT_EQ(vi[1].second, 2);
+
+  EXPECT_TRUE(redis.addSingleValue("ghi", string("xyz")).ok());
+  RA::TimeValList<string> vs;
+  EXPECT_TRUE(redis.getValuesBefore("ghi", vs, { .count = 1 }));
+  ASSERT_EQ(vs.size(), 1);
+  EXPECT_EQ(vs[0].second, "xyz");
+
+  //  an Attrs keeps the fields the entry has and loses the others
+  RA::TimeValList<RA::Attrs> va = {{ 0, {{ "_", "old" }, { "stale", "1" }}}};
+  const string* field = &va[0].second.at("_");
+  EXPECT_TRUE(redis.getValuesBefore("ghi", va, { .count = 1 }));
+  ASSERT_EQ(va.size(), 1);
+  EXPECT_EQ(va[0].second.size(), 1);
+  EXPECT_EQ(&va[0].second.at("_"), field);
+  EXPECT_EQ(va[0].second.at("_"), "xyz");
+}
+
 TEST(RedisAdapter, DataReader)
 {
   RedisAdapter redis("TEST");
@@ -260,6 +634,31 @@ TEST(RedisAdapter, DataReader)
   EXPECT_TRUE(waiting);
 }
 
+TEST(RedisAdapter, RemoveReaderWaits)
+{
+  RedisAdapter redis("TEST");
+
+  //  a slow callback for one tag, so removing that tag finds it running or queued
+  int tag = 0;
+  atomic<int> started = 0, finished = 0;
+  EXPECT_TRUE(redis.addValuesReader<int>("rwait", [&](const string&, const string&, const RA::TimeValList<int>&)
+    {
+      started++;
+      this_thread::sleep_for(milliseconds(50));
+      finished++;
+    }, "", &tag));
+  this_thread::sleep_for(milliseconds(5));
+
+  EXPECT_TRUE(redis.addSingleValue("rwait", 1).ok());
+  for (int i = 0; i < 20 && started == 0; i++)
+    this_thread::sleep_for(milliseconds(5));
+  EXPECT_EQ(started, 1);
+
+  //  removal returns only after the callback is done
+  EXPECT_TRUE(redis.removeReader("rwait", "", &tag));
+  EXPECT_EQ(finished, 1);
+}
+
 TEST(RedisAdapter, DeferReader)
 {
   RedisAdapter redis("TEST");
@@ -506,6 +905,72 @@ TEST(RedisAdapter, MultiReader)
   EXPECT_FALSE(waiting);
 }
 
+TEST(RedisAdapter, BlockingReaders)
+{
+  //  more blocking readers than command pool connections - the readers each lease a
+  //  dedicated connection, so writes never wait on a reader's blocking read
+  RA_Options opts; opts.readers = 8; opts.cxn.size = 1;
+  RedisAdapter redis("TEST", opts);
+
+  atomic<int> reads{0};
+  vector<string> bases = { "BLK0", "BLK1", "BLK2", "BLK3", "BLK4", "BLK5", "BLK6", "BLK7" };
+
+  for (const auto& base : bases)
+  {
+    EXPECT_TRUE(redis.addValuesReader<int>("blk", [&](const string&, const string&, const RA::TimeValList<int>&)
+      { reads++; }, base
+    ));
+  }
+  this_thread::sleep_for(milliseconds(50));   //  let the readers block
+
+  auto beg = steady_clock::now();
+  for (int i = 0; i < 10; i++) { EXPECT_TRUE(redis.addSingleValue("blk", i).ok()); }
+  auto end = steady_clock::now();
+
+  //  with readers on the command pool each write could wait out a whole blocking read
+  EXPECT_LT(duration_cast<milliseconds>(end - beg).count(), opts.cxn.timeout);
+
+  auto stats = redis.blockingStats();
+  EXPECT_GT(stats.open, 0);
+  EXPECT_GE(stats.leases, stats.open);
+  EXPECT_EQ(stats.timeouts, 0);
+}
+
+TEST(RedisAdapter, ReaderRecovers)
+{
+  RedisAdapter redis("TEST");
+
+  atomic<int> last{0};
+  EXPECT_TRUE(redis.addValuesReader<int>("recover", [&](const string&, const string&, const RA::TimeValList<int>& ats)
+    { last = ats.back().second; }
+  ));
+  this_thread::sleep_for(milliseconds(5));
+
+  //  read something first, so the reader goes on after it rather than from '$'
+  EXPECT_TRUE(redis.addSingleValue("recover", 1).ok());
+  for (int i = 0; i < 20 && last != 1; i++)
+    this_thread::sleep_for(milliseconds(5));
+  EXPECT_EQ(last, 1);
+
+  //  kill only the reader's blocking connection, as a failover would - the command pool
+  //  is untouched, so nothing else tells the adapter anything went wrong
+  Redis admin(ConnectionOptions{});
+  istringstream clients(admin.command<string>("CLIENT", "LIST"));
+  long long killed = 0;
+  for (string line; getline(clients, line); )
+  {
+    if (line.find(" cmd=xread") == string::npos) continue;
+    killed += admin.command<long long>("CLIENT", "KILL", "ID", line.substr(3, line.find(' ') - 3));
+  }
+  EXPECT_GT(killed, 0);
+
+  //  the reader leases a new connection and reads on
+  EXPECT_TRUE(redis.addSingleValue("recover", 2).ok());
+  for (int i = 0; i < 100 && last != 2; i++)
+    this_thread::sleep_for(milliseconds(10));
+  EXPECT_EQ(last, 2);
+}
+
 TEST(RedisAdapter, Utility)
 {
   RedisAdapter redis("TEST");
@@ -550,11 +1015,647 @@ TEST(RedisAdapter, Watchdog)
   //  wait past expire time and check manual dog gone
   this_thread::sleep_for(milliseconds(600));
   EXPECT_EQ(redis.getWatchdogs().size(), 1);
+
+  //  a dog kept alive by the hub on a period of its own, well past its expiration
+  EXPECT_TRUE(redis.startWatchdog("KEPT", 1, 500));
+  this_thread::sleep_for(milliseconds(1500));
+  EXPECT_EQ(redis.getWatchdogs().size(), 2);
+
+  //  stopped dogs are left to expire
+  EXPECT_TRUE(redis.stopWatchdog("KEPT"));
+  EXPECT_FALSE(redis.stopWatchdog("KEPT"));
+  this_thread::sleep_for(milliseconds(1200));
+  EXPECT_EQ(redis.getWatchdogs().size(), 1);
+}
+
+TEST(RedisHub, Watchdogs)
+{
+  //  the watchdogs of all the devices on a hub are kept alive by one thread
+  auto hub = make_shared<RedisHub>();
+  vector<unique_ptr<RedisAdapter>> devs;
+  for (int i = 0; i < 50; i++) { devs.push_back(make_unique<RedisAdapter>("DOG" + to_string(i), hub, "DOG")); }
+
+  this_thread::sleep_for(milliseconds(1500));
+  for (auto& dev : devs) { EXPECT_EQ(dev->getWatchdogs().size(), 1); }
+
+  //  a device going away takes its dog with it
+  auto dev = devs.back().get();
+  EXPECT_TRUE(dev->startWatchdog("SLOW", 2, 1500));
+  this_thread::sleep_for(milliseconds(2500));
+  EXPECT_EQ(dev->getWatchdogs().size(), 2);
+
+  devs.pop_back();
+  RedisAdapter redis("DOG49");
+  this_thread::sleep_for(milliseconds(2200));
+  EXPECT_EQ(redis.getWatchdogs().size(), 0);
+  EXPECT_EQ(devs.front()->getWatchdogs().size(), 1);
+}
+
+TEST(RedisAdapter, PubSub)
+{
+  RedisAdapter redis("TEST");
+
+  bool waiting = true;
+  string heard;
+
+  //  first subscription starts the listener
+  EXPECT_TRUE(redis.subscribe("chn", [&](const string& base, const string& sub, const string& msg)
+    {
+      EXPECT_STREQ(base.c_str(), "TEST");
+      EXPECT_STREQ(sub.c_str(), "chn");
+      heard = msg;
+      waiting = false;
+    }
+  ));
+  this_thread::sleep_for(milliseconds(20));
+
+  EXPECT_TRUE(redis.publish("chn", "abc"));
+
+  for (int i = 0; i < 20 && waiting; i++)
+    this_thread::sleep_for(milliseconds(5));
+
+  EXPECT_FALSE(waiting);
+  EXPECT_STREQ(heard.c_str(), "abc");
+
+  //  pattern added while the listener is running
+  EXPECT_TRUE(redis.psubscribe("pat*", [&](const string& base, const string& sub, const string& msg)
+    {
+      EXPECT_STREQ(base.c_str(), "TEST");
+      EXPECT_STREQ(sub.c_str(), "pattern");
+      heard = msg;
+      waiting = false;
+    }
+  ));
+  this_thread::sleep_for(milliseconds(20));
+
+  waiting = true;
+  EXPECT_TRUE(redis.publish("pattern", "def"));
+
+  for (int i = 0; i < 20 && waiting; i++)
+    this_thread::sleep_for(milliseconds(5));
+
+  EXPECT_FALSE(waiting);
+  EXPECT_STREQ(heard.c_str(), "def");
+
+  //  unsubscribe and check nothing more is heard
+  EXPECT_TRUE(redis.unsubscribe("chn"));
+  EXPECT_TRUE(redis.unsubscribe("pat*"));
+  EXPECT_FALSE(redis.unsubscribe("chn"));
+  this_thread::sleep_for(milliseconds(20));
+
+  waiting = true;
+  EXPECT_TRUE(redis.publish("chn", "ghi"));
+  EXPECT_TRUE(redis.publish("pattern", "jkl"));
+
+  for (int i = 0; i < 20 && waiting; i++)
+    this_thread::sleep_for(milliseconds(5));
+
+  EXPECT_TRUE(waiting);
+}
+
+TEST(RedisHub, SharedAdapters)
+{
+  auto hub = make_shared<RedisHub>();
+  EXPECT_TRUE(hub->connected());
+
+  //  many devices on one hub, each reading its own status
+  vector<unique_ptr<RedisAdapter>> devs;
+  atomic<int> seen = 0;
+  for (int i = 0; i < 50; i++)
+  {
+    devs.push_back(make_unique<RedisAdapter>("HUB" + to_string(i), hub));
+    EXPECT_TRUE(devs.back()->addValuesReader<int>("status", [&, i](const string& base, const string& sub, const RA::TimeValList<int>& ats)
+      {
+        EXPECT_STREQ(base.c_str(), ("HUB" + to_string(i)).c_str());
+        EXPECT_STREQ(sub.c_str(), "status");
+        if (ats.size() && ats[0].second == i) seen++;
+      }
+    ));
+  }
+  EXPECT_EQ(hub->adapters(), 50);
+  this_thread::sleep_for(milliseconds(5));
+
+  for (int i = 0; i < 50; i++) { EXPECT_TRUE(devs[i]->addSingleValue("status", i).ok()); }
+
+  for (int i = 0; i < 100 && seen < 50; i++)
+    this_thread::sleep_for(milliseconds(5));
+
+  EXPECT_EQ(seen, 50);
+
+  //  another adapter reading the same key, which goes away again
+  {
+    RedisAdapter other("TEST", hub);
+    bool waiting = true;
+    EXPECT_TRUE(other.addValuesReader<int>("status", [&](const string& base, const string&, const RA::TimeValList<int>&)
+      {
+        EXPECT_STREQ(base.c_str(), "HUB1");
+        waiting = false;
+      }, "HUB1"
+    ));
+    this_thread::sleep_for(milliseconds(5));
+
+    seen = 0;
+    EXPECT_TRUE(devs[1]->addSingleValue("status", 1).ok());
+
+    for (int i = 0; i < 20 && (waiting || seen < 1); i++)
+      this_thread::sleep_for(milliseconds(5));
+
+    EXPECT_FALSE(waiting);
+    EXPECT_EQ(seen, 1);
+  }
+  EXPECT_EQ(hub->adapters(), 50);
+
+  //  devices going away leave the others reading
+  devs.erase(devs.begin(), devs.begin() + 25);
+  EXPECT_EQ(hub->adapters(), 25);
+  this_thread::sleep_for(milliseconds(5));
+
+  seen = 0;
+  for (int i = 0; i < 25; i++) { EXPECT_TRUE(devs[i]->addSingleValue("status", 25 + i).ok()); }
+
+  for (int i = 0; i < 100 && seen < 25; i++)
+    this_thread::sleep_for(milliseconds(5));
+
+  EXPECT_EQ(seen, 25);
+
+  for (auto& dev : devs) { EXPECT_TRUE(dev->del("status")); }
+}
+
+TEST(RedisHub, ConnectionState)
+{
+  //  a hub that cannot connect keeps retrying with backoff and reports the state once
+  RA_Options opts;
+  opts.cxn.mode = RedisConnection::Mode::SINGLE;
+  opts.cxn.port = 1;
+  opts.backoff = 10;
+  opts.backoffMax = 50;
+  auto hub = make_shared<RedisHub>(opts);
+
+  atomic<int> downs = 0, ups = 0;
+  hub->setConnectionCallback([&](bool connected) { connected ? ups++ : downs++; });
+
+  EXPECT_FALSE(hub->connected());
+  EXPECT_FALSE(hub->connected());
+  this_thread::sleep_for(milliseconds(300));
+
+  EXPECT_EQ(downs, 1);
+  EXPECT_EQ(ups, 0);
+
+  //  and gives up promptly when destroyed in the middle of it
+  auto t0 = steady_clock::now();
+  hub.reset();
+  EXPECT_LT(duration_cast<milliseconds>(steady_clock::now() - t0).count(), 500);
+}
+
+TEST(RA_Buffer, Ring)
+{
+  auto entry = [](int64_t time) { return RA_Buffer::Entry{ time, 0, true, {{ "_", string(100, 'x') }} }; };
+
+  //  a ring that holds a few entries drops the oldest as it wraps
+  RA_Buffer ring(1024, 0);
+  ASSERT_TRUE(ring.ok());
+  uint64_t dropped = 0;
+  for (int i = 1; i <= 20; i++) { EXPECT_TRUE(ring.push(entry(i), dropped)); }
+  EXPECT_GT(ring.entries(), 0);
+  EXPECT_EQ(ring.entries() + dropped, 20);
+
+  vector<RA_Buffer::Entry> out;
+  uint64_t first = ring.peek(100, out);
+  ASSERT_EQ(out.size(), ring.entries());
+  for (size_t i = 0; i < out.size(); i++) { EXPECT_EQ(out[i].time, 20 - (int64_t)out.size() + 1 + (int64_t)i); }
+  EXPECT_EQ(out.back().attrs.find("_")->second, string(100, 'x'));
+
+  //  popping what was peeked leaves what came after
+  EXPECT_TRUE(ring.push(entry(21), dropped));
+  ring.pop(first + out.size());
+  EXPECT_EQ(ring.entries(), 1);
+  EXPECT_EQ(ring.last(), 21);
+
+  //  the fields come back in the order they were pushed, as the add would have sent them
+  EXPECT_TRUE(ring.push({ 22, 0, true, {{ "c", "1" }, { "a", "2" }, { "b", "3" }} }, dropped));
+  out.clear();
+  ring.peek(100, out);
+  ASSERT_EQ(out.size(), 2);
+  ASSERT_EQ(out[1].attrs.size(), 3);
+  EXPECT_EQ(out[1].attrs[0].first, "c");
+  EXPECT_EQ(out[1].attrs[1].first, "a");
+  EXPECT_EQ(out[1].attrs[2].first, "b");
+  EXPECT_EQ(out[1].attrs[2].second, "3");
+
+  //  too big for the ring at all
+  EXPECT_FALSE(ring.push({ 23, 0, true, {{ "_", string(2000, 'x') }} }, dropped));
+
+  //  the entry limit
+  RA_Buffer few(1 << 16, 5);
+  dropped = 0;
+  for (int i = 1; i <= 10; i++) { few.push(entry(i), dropped); }
+  EXPECT_EQ(few.entries(), 5);
+  EXPECT_EQ(dropped, 5);
+
+  //  a file ring is taken over by the next ring of its size
+  string path = "/tmp/ra_buffer_test.ring";
+  unlink(path.c_str());
+  {
+    RA_Buffer file(4096, 0, path);
+    for (int i = 1; i <= 3; i++) { file.push(entry(i), dropped); }
+  }
+  {
+    RA_Buffer file(4096, 0, path);
+    out.clear();
+    file.peek(10, out);
+    ASSERT_EQ(out.size(), 3);
+    EXPECT_EQ(out[2].time, 3);
+  }
+  RA_Buffer other(8192, 0, path);
+  EXPECT_EQ(other.entries(), 0);
+  unlink(path.c_str());
+}
+
+TEST(RedisAdapter, OutageBuffer)
+{
+  string path = "/tmp/ra_outage_test.ring";
+  unlink(path.c_str());
+
+  RA_BufferOptions bufopts;
+  bufopts.path = path;
+  bufopts.maxEntries = 5;
+  {
+    //  a producer that cannot reach its server keeps the newest adds in the buffer
+    RA_Options opts;
+    opts.cxn.mode = RedisConnection::Mode::SINGLE;
+    opts.cxn.port = 1;
+    opts.backoff = 10;
+    opts.backoffMax = 50;
+    RedisAdapter redis("TEST", opts);
+
+    EXPECT_TRUE(redis.startOutageBuffer("outage", bufopts));
+    EXPECT_FALSE(redis.startOutageBuffer("outage", bufopts));
+
+    for (int i = 0; i < 10; i++) { EXPECT_TRUE(redis.addSingleValue("outage", i, { .trim = 0 }).ok()); }
+    EXPECT_FALSE(redis.addSingleValue("unbuffered", 0).ok());
+
+    //  an entry that would go before the buffered ones is refused
+    EXPECT_FALSE(redis.addSingleValue("outage", 10, { .time = 1000 }).ok());
+
+    auto stats = redis.outageStats("outage");
+    EXPECT_EQ(stats.buffered, 10);
+    EXPECT_EQ(stats.dropped, 6);
+    EXPECT_EQ(stats.entries, 5);
+    EXPECT_EQ(stats.replayed, 0);
+  }
+  {
+    //  the file carries them over to a producer that can, which adds them in order
+    RedisAdapter redis("TEST");
+    redis.del("outage");
+    EXPECT_TRUE(redis.startOutageBuffer("outage", bufopts));
+
+    for (int i = 0; i < 100 && redis.outageStats("outage").replayed < 5; i++) { this_thread::sleep_for(milliseconds(10)); }
+
+    auto stats = redis.outageStats("outage");
+    EXPECT_EQ(stats.replayed, 5);
+    EXPECT_EQ(stats.entries, 0);
+
+    auto vals = redis.getValues<int>("outage");
+    ASSERT_EQ(vals.size(), 5);
+    for (int i = 0; i < 5; i++) { EXPECT_EQ(vals[i].second, i + 5); }
+
+    //  with nothing waiting adds go straight to the stream
+    EXPECT_TRUE(redis.addSingleValue("outage", 10, { .trim = 0 }).ok());
+    EXPECT_EQ(redis.outageStats("outage").buffered, 0);
+    EXPECT_TRUE(redis.stopOutageBuffer("outage"));
+    EXPECT_FALSE(redis.stopOutageBuffer("outage"));
+  }
+  unlink(path.c_str());
+}
+
+TEST(RedisCache, Wait)
+{
+  auto redis = make_shared<RedisAdapter>("TEST");
+  redis->del("cache-wait");
+  RedisCache<float> cache(redis, "cache-wait");
+  this_thread::sleep_for(milliseconds(5));
+
+  //  with nothing written the timed waits time out
+  EXPECT_EQ(cache.waitForNewValueFor(milliseconds(20)), 0);
+  EXPECT_EQ(cache.waitUntil(steady_clock::now() + milliseconds(20)), 0);
+  EXPECT_EQ(cache.waitForSequence(cache.sequence(), milliseconds(20)), 0);
+
+  //  a write wakes a waiter blocked in another thread, with the frame already there
+  uint64_t seen = cache.sequence();
+  uint64_t woke = 0;
+  thread waiter([&] { woke = cache.waitForNewValueFor(seconds(1)); });
+  this_thread::sleep_for(milliseconds(5));
+
+  vector<float> vf = { 1.23, 3.45, 5.67 };
+  RA_Time time = redis->addSingleList("cache-wait", vf);
+  EXPECT_TRUE(time.ok());
+  waiter.join();
+  EXPECT_GT(woke, seen);
+  vector<float> read;
+  EXPECT_EQ(cache.copyReadBuffer(read).value, time.value);
+  EXPECT_EQ(read, vf);
+
+  //  the waiter took the flag, the sequence is still there for any other waiter
+  EXPECT_FALSE(cache.newValueAvaliable());
+  EXPECT_EQ(cache.waitForNewValueFor(milliseconds(20)), 0);
+  EXPECT_EQ(cache.waitForSequence(seen, milliseconds(20)), woke);
+}
+
+TEST(RedisCache, Frames)
+{
+  auto redis = make_shared<RedisAdapter>("TEST");
+  redis->del("cache-frames");
+
+  vector<int> vi(100, 0);
+  EXPECT_TRUE(redis->addSingleList("cache-frames", vi).ok());
+
+  //  frames are written while the cache loads and while it is read, a read never sees a frame
+  //  change under it or one older than it saw before
+  atomic<bool> writing{true};
+  RA_Time last;
+  thread writer([&]
+    {
+      for (int i = 1; writing; i++)
+      {
+        vector<int> data(100, i);
+        last = redis->addSingleList("cache-frames", data);
+        this_thread::sleep_for(microseconds(200));
+      }
+    }
+  );
+  this_thread::sleep_for(milliseconds(5));
+  RedisCache<int> cache(redis, "cache-frames");
+
+  int64_t seen = 0;
+  vector<int> data;
+  for (auto end = steady_clock::now() + milliseconds(50); steady_clock::now() < end; )
+  {
+    RA_Time time = cache.copyReadBuffer(data);
+    EXPECT_GE(time.value, seen);
+    seen = time.value;
+    ASSERT_EQ(data.size(), 100);
+    EXPECT_EQ(count(data.begin(), data.end(), data[0]), 100);
+  }
+  writing = false;
+  writer.join();
+
+  //  whichever of the load and the reader published first, the cache ends on the last frame
+  for (int i = 0; i < 20 && cache.copyReadBuffer(data).value != last.value; i++)
+    this_thread::sleep_for(milliseconds(5));
+  EXPECT_EQ(cache.copyReadBuffer(data).value, last.value);
+}
+
+TEST(RedisCache, Snapshot)
+{
+  auto redis = make_shared<RedisAdapter>("TEST");
+  redis->del("cache-snap");
+  RedisCache<float> cache(redis, "cache-snap");
+  this_thread::sleep_for(milliseconds(5));
+
+  //  write a frame and wait for the cache to have it
+  auto write = [&](float value)
+    {
+      vector<float> vf(10, value);
+      RA_Time time = redis->addSingleList("cache-snap", vf);
+      for (int i = 0; i < 20 && cache.snapshot()->time.value != time.value; i++)
+        this_thread::sleep_for(milliseconds(5));
+      return time;
+    };
+  write(0);
+
+  //  a held frame does not change however many writes come after it
+  RA_Time time = write(1);
+  auto held = cache.snapshot();
+  EXPECT_EQ(held->time.value, time.value);
+  for (int i = 2; i < 10; i++) { write(i); }
+  EXPECT_EQ(held->time.value, time.value);
+  EXPECT_EQ(held->data, vector<float>(10, 1));
+
+  //  the latest frame is shared rather than copied, copyReadBuffer copies the same data
+  EXPECT_EQ(cache.snapshot(), cache.snapshot());
+  vector<float> vf;
+  EXPECT_EQ(cache.copyReadBuffer(vf).value, cache.snapshot()->time.value);
+  EXPECT_EQ(vf, vector<float>(10, 9));
+
+  //  a frame let go goes back to the writer's pool to be filled again, rather than freed
+  weak_ptr<const RedisCache<float>::Frame> pooled = held;
+  held.reset();
+  for (int i = 10; i < 20; i++) { write(i); }
+  EXPECT_FALSE(pooled.expired());
+}
+
+TEST(RedisCache, History)
+{
+  auto redis = make_shared<RedisAdapter>("TEST");
+  redis->del("cache-hist");
+
+  vector<RA_Time> times;
+  for (int i = 0; i < 5; i++)
+  {
+    vector<int> vi(10, i);
+    times.push_back(redis->addSingleList("cache-hist", vi, { .trim = 0 }));
+  }
+
+  //  the history is loaded with the last depth frames, oldest first
+  RedisCache<int> cache(redis, "cache-hist", 3);
+  EXPECT_EQ(cache.depth(), 3);
+  auto frames = cache.frames();
+  ASSERT_EQ(frames->size(), 3);
+  for (int i = 0; i < 3; i++)
+  {
+    EXPECT_EQ((*frames)[i]->time.value, times[i + 2].value);
+    EXPECT_EQ((*frames)[i]->data[0], i + 2);
+  }
+
+  //  a time finds the newest frame not after it, none if the history holds none that old
+  vector<int> vi;
+  EXPECT_EQ(cache.copyAt(times[3].value + 1, vi).value, times[3].value);
+  EXPECT_EQ(vi[0], 3);
+  EXPECT_EQ(cache.copyAt(times[4], vi).value, times[4].value);
+  EXPECT_EQ(vi[0], 4);
+  EXPECT_EQ(cache.copyAt(times[1], vi).value, 0);
+  EXPECT_EQ(vi[0], 4);
+  EXPECT_EQ(cache.snapshotAt(times[2].value - 1), nullptr);
+
+  //  latestN shares at most the frames there are
+  auto latest = cache.latestN(2);
+  ASSERT_EQ(latest.size(), 2);
+  EXPECT_EQ(latest[0]->time.value, times[3].value);
+  EXPECT_EQ(latest[1]->time.value, times[4].value);
+  EXPECT_EQ(cache.latestN(10).size(), 3);
+
+  //  a write pushes the oldest frame out, a history held from before stays as it was
+  this_thread::sleep_for(milliseconds(5));
+  vi.assign(10, 5);
+  RA_Time time = redis->addSingleList("cache-hist", vi, { .trim = 0 });
+  for (int i = 0; i < 20 && cache.snapshot()->time.value != time.value; i++)
+    this_thread::sleep_for(milliseconds(5));
+  ASSERT_EQ(cache.frames()->size(), 3);
+  EXPECT_EQ(cache.frames()->front()->time.value, times[3].value);
+  EXPECT_EQ(cache.frames()->back()->time.value, time.value);
+  EXPECT_EQ(frames->front()->time.value, times[2].value);
+}
+
+TEST(RedisCacheManager, Budget)
+{
+  auto redis = make_shared<RedisAdapter>("TEST");
+
+  vector<float> vf(100, 1.23);
+  for (auto key : { "mgr0", "mgr1", "mgr2" }) { EXPECT_TRUE(redis->addSingleList(key, vf).ok()); }
+  redis->del("mgrx");
+
+  //  what one of the keys counts against the budget
+  size_t bytes;
+  {
+    RedisCacheManager<float> probe(redis, 1 << 20);
+    probe.snapshot("mgr0");
+    bytes = probe.stats().bytes;
+  }
+
+  //  a budget with room for two of them
+  RedisCacheManager<float> manager(redis, bytes * 5 / 2);
+  EXPECT_TRUE(manager.watch({ "mgr0", "mgr1", "mgr2" }));
+
+  //  a first read is a miss, a later one a hit that shares the same frame
+  auto frame = manager.snapshot("mgr0");
+  EXPECT_EQ(frame->data, vf);
+  EXPECT_EQ(manager.snapshot("mgr0"), frame);
+  manager.snapshot("mgr1");
+
+  auto stats = manager.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.evictions, 0);
+  EXPECT_EQ(stats.entries, 2);
+  EXPECT_EQ(stats.bytes, bytes * 2);
+
+  //  a third key drops the least recently read
+  manager.snapshot("mgr0");
+  manager.snapshot("mgr2");
+
+  stats = manager.stats();
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.misses, 3);
+  EXPECT_EQ(stats.evictions, 1);
+  EXPECT_EQ(stats.entries, 2);
+  EXPECT_LE(stats.bytes, manager.budget());
+
+  manager.snapshot("mgr0");
+  manager.snapshot("mgr1");
+
+  stats = manager.stats();
+  EXPECT_EQ(stats.hits, 3);
+  EXPECT_EQ(stats.misses, 4);
+  EXPECT_EQ(stats.evictions, 2);
+
+  //  a key with no data is never a hit, each read asks redis again
+  EXPECT_EQ(manager.snapshot("mgrx")->time.value, 0);
+  EXPECT_EQ(manager.snapshot("mgrx")->time.value, 0);
+  vector<float> dest = { 0 };
+  EXPECT_EQ(manager.copyReadBuffer("mgrx", dest).value, 0);
+  EXPECT_TRUE(dest.empty());
+
+  stats = manager.stats();
+  EXPECT_EQ(stats.hits, 3);
+  EXPECT_EQ(stats.misses, 7);
+
+  //  destroying another manager on the key removes only its own reader
+  {
+    RedisCacheManager<float> other(redis, 1 << 20);
+    EXPECT_TRUE(other.watch({ "mgr0" }));
+  }
+
+  //  the reader of a cached key keeps its frame current
+  this_thread::sleep_for(milliseconds(5));
+  vf.assign(100, 4.56);
+  RA_Time time = redis->addSingleList("mgr0", vf);
+  for (int i = 0; i < 20 && manager.snapshot("mgr0")->time.value != time.value; i++)
+    this_thread::sleep_for(milliseconds(5));
+  EXPECT_EQ(manager.snapshot("mgr0")->data, vf);
+}
+
+TEST(RedisValueCache, Scalar)
+{
+  auto redis = make_shared<RedisAdapter>("TEST");
+  redis->del("vcache");
+  RA_Time time = redis->addSingleValue("vcache", 5);
+
+  static_assert(RedisValueCache<int>::lockFree, "an int is kept in the seqlock");
+
+  //  the value is loaded on construction
+  auto cache = make_unique<RedisValueCache<int>>(redis, "vcache");
+  RedisValueCache<int> other(redis, "vcache");
+  auto frame = cache->read();
+  EXPECT_EQ(frame.time.value, time.value);
+  EXPECT_EQ(frame.value, 5);
+  uint64_t seen = cache->sequence();
+  EXPECT_EQ(seen, 1);
+
+  //  the reader stores later values
+  this_thread::sleep_for(milliseconds(5));
+  time = redis->addSingleValue("vcache", 6);
+  for (int i = 0; i < 20 && cache->sequence() == seen; i++)
+    this_thread::sleep_for(milliseconds(5));
+  int value = 0;
+  EXPECT_EQ(cache->copyReadValue(value).value, time.value);
+  EXPECT_EQ(value, 6);
+
+  //  destroying one cache removes only its reader, the other keeps reading the key
+  cache.reset();
+  this_thread::sleep_for(milliseconds(20));
+  time = redis->addSingleValue("vcache", 7);
+  for (int i = 0; i < 20 && other.read().time.value != time.value; i++)
+    this_thread::sleep_for(milliseconds(5));
+  EXPECT_EQ(other.read().time.value, time.value);
+  EXPECT_EQ(other.read().value, 7);
+
+  //  a key with no data has no value, copyReadValue leaves the destination alone
+  redis->del("vcache-none");
+  RedisValueCache<int> none(redis, "vcache-none");
+  EXPECT_EQ(none.read().time.value, 0);
+  EXPECT_EQ(none.copyReadValue(value).value, 0);
+  EXPECT_EQ(value, 6);
+}
+
+TEST(RedisValueCache, String)
+{
+  auto redis = make_shared<RedisAdapter>("TEST");
+  redis->del("vcache-str");
+  RA_Time time = redis->addSingleValue<string>("vcache-str", "xxx");
+
+  static_assert( ! RedisValueCache<string>::lockFree, "a string is kept in shared frames");
+
+  //  the frame is shared rather than copied
+  RedisValueCache<string> cache(redis, "vcache-str");
+  auto held = cache.snapshot();
+  EXPECT_EQ(held->time.value, time.value);
+  EXPECT_EQ(held->value, "xxx");
+  EXPECT_EQ(cache.snapshot(), held);
+
+  //  a later value is a new frame, a held one stays as it was
+  this_thread::sleep_for(milliseconds(5));
+  time = redis->addSingleValue<string>("vcache-str", "yyy");
+  for (int i = 0; i < 20 && cache.read().time.value != time.value; i++)
+    this_thread::sleep_for(milliseconds(5));
+  EXPECT_EQ(cache.read().value, "yyy");
+  EXPECT_EQ(held->value, "xxx");
+
+  string value;
+  EXPECT_EQ(cache.copyReadValue(value).value, time.value);
+  EXPECT_EQ(value, "yyy");
+  EXPECT_EQ(cache.sequence(), 2);
+
+  //  a key with no data has an empty frame
+  redis->del("vcache-none");
+  RedisValueCache<string> none(redis, "vcache-none");
+  EXPECT_EQ(none.snapshot()->time.value, 0);
+  EXPECT_EQ(none.copyReadValue(value).value, 0);
+  EXPECT_EQ(value, "yyy");
 }
 
 TEST(RedisConnection, ConcurrentConnect)
 {
-  //  connect() replaces the live _cluster/_singler client objects - if that's not
+  //  connect() replaces the live cluster/singler client objects - if that's not
   //  synchronized against every other method that dereferences them, hammering
   //  connect() concurrently with normal traffic from other threads corrupts the
   //  heap (this is what caused the production data-mover crashes)
@@ -586,3 +1687,57 @@ TEST(RedisConnection, ConcurrentConnect)
   stop = true;
   for (auto& t : users) { t.join(); }
 }
+
+TEST(RedisConnection, ConnectModes)
+{
+  //  the first AUTO connection probes, the rest use the cached type
+  RedisConnection::Options opts;
+  RedisConnection probe(opts);
+  ASSERT_TRUE(probe.ping());
+
+  auto t0 = steady_clock::now();
+  vector<unique_ptr<RedisConnection>> conns;
+  for (int i = 0; i < 100; i++) { conns.push_back(make_unique<RedisConnection>(opts)); }
+  for (auto& conn : conns) { EXPECT_TRUE(conn->ping()); }
+  EXPECT_LT(duration_cast<milliseconds>(steady_clock::now() - t0).count(), 1000);
+
+  //  a lazy single server connection makes no connection until used
+  opts.mode = RedisConnection::Mode::SINGLE;
+  opts.lazy = true;
+  RedisConnection lazy(opts);
+  EXPECT_TRUE(lazy.ping());
+
+  //  and a lazy one to nowhere only fails when used
+  opts.port = 1;
+  RedisConnection nowhere(opts);
+  EXPECT_FALSE(nowhere.ping());
+}
+
+TEST(RedisConnection, ShardedServers)
+{
+  //  two names for the one test server - the ring treats them as two servers
+  RedisConnection::Options opts;
+  opts.shards = { "127.0.0.1:6379", "localhost:6379" };
+  RedisConnection conn(opts);
+  ASSERT_TRUE(conn.ping());
+
+  //  keys spread over both, and all keys of a base key stay together
+  unordered_map<string, int> nodes;
+  for (int i = 0; i < 100; i++)
+  {
+    string base = "{SHARD" + to_string(i) + "}";
+    nodes[conn.node(base)]++;
+    EXPECT_EQ(conn.node(base + ":a"), conn.node(base + ":b"));
+  }
+  EXPECT_EQ(nodes.size(), 2);
+
+  //  the adapter works unchanged on top
+  RA_Options ra;
+  ra.cxn = opts;
+  RedisAdapter redis("TEST", ra);
+  EXPECT_TRUE(redis.addSingleValue("sharded", 42).ok());
+  int value = 0;
+  EXPECT_TRUE(redis.getSingleValue("sharded", value).ok());
+  EXPECT_EQ(value, 42);
+  EXPECT_EQ(redis.getSingleValueAsync<int>("sharded").get().second, 42);
+}